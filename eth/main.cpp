@@ -123,6 +123,9 @@ void help()
         << "    -v,--verbosity <0 - 9>  Set the log verbosity from 0 to 9 (Default: 8)." << endl
         << "    -x,--peers <number>  Attempt to connect to given number of peers (Default: 5)." << endl
         << "    -V,--version  Show the version and exit." << endl
+		<< "    --threaded-vm  Use the threaded EVM interpreter (default: off)." << endl
+		<< "    --flat-state  Keep a flat snapshot of the state for fast account and storage reads (default: off)." << endl
+		<< "    --speculative-sync  Execute pending transactions concurrently when assembling a block (default: off)." << endl
 #if ETH_EVMJIT
 		<< "    --jit  Use EVM JIT (default: off)." << endl
 #endif
@@ -205,6 +208,7 @@ int main(int argc, char** argv)
 	bool useLocal = false;
 	bool forceMining = false;
 	bool jit = false;
+	bool threadedVM = false;
 	string clientName;
 
 	// Init defaults
@@ -308,6 +312,12 @@ int main(int argc, char** argv)
 				return -1;
 			}
 		}
+		else if (arg == "--threaded-vm")
+			threadedVM = true;
+		else if (arg == "--flat-state")
+			StateSnapshot::setEnabled(true);
+		else if (arg == "--speculative-sync")
+			State::setSpeculative(true);
 		else if (arg == "--jit")
 		{
 #if ETH_EVMJIT
@@ -330,7 +340,7 @@ int main(int argc, char** argv)
 
 	cout << credits();
 
-	VMFactory::setKind(jit ? VMKind::JIT : VMKind::Interpreter);
+	VMFactory::setKind(jit ? VMKind::JIT : threadedVM ? VMKind::Threaded : VMKind::Interpreter);
 	NetworkPreferences netPrefs(listenPort, publicIP, upnp, useLocal);
 	dev::WebThreeDirect web3(
 		"Ethereum(++)/" + clientName + "v" + dev::Version + "/" DEV_QUOTED(ETH_BUILD_TYPE) "/" DEV_QUOTED(ETH_BUILD_PLATFORM) + (jit ? "/JIT" : ""),
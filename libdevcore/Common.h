@@ -34,6 +34,7 @@
 #endif
 
 #include <map>
+#include <unordered_map>
 #include <vector>
 #include <set>
 #pragma warning(push)
@@ -75,10 +76,24 @@ using u160s = std::vector<u160>;
 using u256Set = std::set<u256>;
 using u160Set = std::set<u160>;
 
+/// A std::hash compatible function object for u256, mixing together the limbs of its value.
+struct u256Hash
+{
+	size_t operator()(u256 const& _v) const
+	{
+		size_t h = 0;
+		for (unsigned i = 0; i < _v.backend().size(); ++i)
+			h ^= (size_t)_v.backend().limbs()[i] + 0x9e3779b9 + (h << 6) + (h >> 2);
+		return h;
+	}
+};
+
 // Map types.
 using StringMap = std::map<std::string, std::string>;
 using u256Map = std::map<u256, u256>;
+using u256HashMap = std::unordered_map<u256, u256, u256Hash>;
 using HexMap = std::map<bytes, std::string>;
+using BytesMap = std::map<bytes, bytes>;
 
 // String types.
 using strings = std::vector<std::string>;
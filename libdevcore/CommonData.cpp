@@ -123,6 +123,18 @@ bytes dev::asNibbles(std::string const& _s)
 	return ret;
 }
 
+bytes dev::asNibbles(bytesConstRef _b)
+{
+	bytes ret;
+	ret.reserve(_b.size() * 2);
+	for (auto i: _b)
+	{
+		ret.push_back(i / 16);
+		ret.push_back(i % 16);
+	}
+	return ret;
+}
+
 std::string dev::toString(string32 const& _s)
 {
 	std::string ret;
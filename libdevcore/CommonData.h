@@ -77,6 +77,9 @@ inline bytes asBytes(std::string const& _b)
 /// @example asNibbles("A")[0] == 4 && asNibbles("A")[1] == 1
 bytes asNibbles(std::string const& _s);
 
+/// Converts a byte array into the big-endian base-16 stream of its bytes.
+bytes asNibbles(bytesConstRef _b);
+
 
 // Big-endian to/from host endian conversion functions.
 
@@ -280,4 +280,6 @@ namespace std
 {
 	/// Forward std::hash<dev::h256> to dev::h256::hash.
 	template<> struct hash<dev::h256>: dev::h256::hash {};
+	/// Forward std::hash<dev::h160> to dev::h160::hash.
+	template<> struct hash<dev::h160>: dev::h160::hash {};
 }
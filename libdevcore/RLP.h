@@ -368,6 +368,9 @@ public:
 	/// Clear the output stream so far.
 	void clear() { m_out.clear(); m_listStack.clear(); }
 
+	/// Make room for at least @a _bytes of output, so that appending that much won't reallocate.
+	void reserve(size_t _bytes) { m_out.reserve(_bytes); }
+
 	/// Read the byte stream.
 	bytes const& out() const { if(!m_listStack.empty()) BOOST_THROW_EXCEPTION(RLPException() << errinfo_comment("listStack is not empty")); return m_out; }
 
@@ -0,0 +1,118 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file ThreadPool.cpp
+ * @date 2015
+ */
+
+#include "ThreadPool.h"
+
+#include "Log.h"
+using namespace std;
+using namespace dev;
+
+ThreadPool::ThreadPool(unsigned _threads)
+{
+	for (unsigned i = 0; i < _threads; ++i)
+		m_threads.emplace_back([this]() { runThread(); });
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		Guard l(x_jobs);
+		m_stop = true;
+	}
+	m_jobsChanged.notify_all();
+	for (auto& t: m_threads)
+		t.join();
+}
+
+ThreadPool& ThreadPool::get()
+{
+	static ThreadPool s_pool;
+	return s_pool;
+}
+
+void ThreadPool::forEach(size_t _count, std::function<void(size_t)> const& _f)
+{
+	if (!_count)
+		return;
+
+	auto job = make_shared<Job>(_count, _f);
+	if (_count > 1 && m_threads.size())
+	{
+		{
+			Guard l(x_jobs);
+			m_jobs.push_back(job);
+		}
+		m_jobsChanged.notify_all();
+	}
+
+	// Lend a hand rather than just waiting.
+	work(*job);
+
+	unique_lock<Mutex> l(x_jobs);
+	m_jobDone.wait(l, [&]() { return !job->remaining; });
+	if (job->error)
+		rethrow_exception(job->error);
+}
+
+void ThreadPool::work(Job& _job)
+{
+	for (size_t i = _job.next++; i < _job.count; i = _job.next++)
+	{
+		try
+		{
+			_job.f(i);
+		}
+		catch (...)
+		{
+			Guard l(x_jobs);
+			if (!_job.error)
+				_job.error = current_exception();
+		}
+		if (!--_job.remaining)
+		{
+			// Take the lock so the notification can't slip in between forEach's check and its wait.
+			Guard l(x_jobs);
+			m_jobDone.notify_all();
+		}
+	}
+}
+
+void ThreadPool::runThread()
+{
+	setThreadName("pool");
+	while (true)
+	{
+		shared_ptr<Job> job;
+		{
+			unique_lock<Mutex> l(x_jobs);
+			m_jobsChanged.wait(l, [&]() { return m_stop || !m_jobs.empty(); });
+			if (m_stop)
+				return;
+			job = m_jobs.front();
+			// Every item is claimed (if not yet finished) once the cursor runs off the end; nobody else needs to see it.
+			if (job->next >= job->count)
+			{
+				m_jobs.pop_front();
+				continue;
+			}
+		}
+		work(*job);
+	}
+}
@@ -0,0 +1,80 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file ThreadPool.h
+ * @date 2015
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "Guards.h"
+
+namespace dev
+{
+
+/**
+ * @brief A fixed set of threads over which independent pieces of work can be spread.
+ * @threadsafe
+ */
+class ThreadPool
+{
+public:
+	/// Spawns @a _threads worker threads (none means everything is run on the calling thread).
+	explicit ThreadPool(unsigned _threads = std::thread::hardware_concurrency());
+	~ThreadPool();
+
+	/// @returns the process-wide pool, with one thread per hardware thread.
+	static ThreadPool& get();
+
+	/// @returns the number of worker threads.
+	unsigned size() const { return m_threads.size(); }
+
+	/// Calls @a _f(i) for each i in [0, @a _count), spread over the worker threads and the calling thread, and returns once
+	/// all calls are done. If any of them throws, the first exception is rethrown here once the others have finished.
+	void forEach(size_t _count, std::function<void(size_t)> const& _f);
+
+private:
+	struct Job
+	{
+		Job(size_t _count, std::function<void(size_t)> const& _f): f(_f), count(_count), remaining(_count) {}
+		std::function<void(size_t)> const& f;
+		size_t count;
+		std::atomic<size_t> next{0};
+		std::atomic<size_t> remaining;
+		std::exception_ptr error;
+	};
+
+	/// Runs items of @a _job until there are none left to claim.
+	void work(Job& _job);
+	void runThread();
+
+	std::vector<std::thread> m_threads;
+	Mutex x_jobs;
+	std::condition_variable m_jobsChanged;
+	std::condition_variable m_jobDone;
+	std::deque<std::shared_ptr<Job>> m_jobs;	///< Jobs that still have unclaimed items.
+	bool m_stop = false;
+};
+
+}
@@ -42,7 +42,11 @@ void Worker::startWorking()
 		while (!m_stop)
 		{
 			if (m_idleWaitMs)
-				this_thread::sleep_for(chrono::milliseconds(m_idleWaitMs));
+			{
+				unique_lock<Mutex> l(x_idle);
+				m_idle.wait_for(l, chrono::milliseconds(m_idleWaitMs), [&](){ return m_woken || m_stop; });
+				m_woken = false;
+			}
 			doWork();
 		}
 		cdebug << "Finishing up worker thread";
@@ -57,9 +61,21 @@ void Worker::stopWorking()
 	if (!m_work)
 		return;
 	cdebug << "Stopping" << m_name;
-	m_stop = true;
+	{
+		Guard l(x_idle);
+		m_stop = true;
+	}
+	m_idle.notify_all();
 	m_work->join();
 	m_work.reset();
 	cdebug << "Stopped" << m_name;
 }
 
+void Worker::wake()
+{
+	{
+		Guard l(x_idle);
+		m_woken = true;
+	}
+	m_idle.notify_one();
+}
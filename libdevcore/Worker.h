@@ -21,6 +21,8 @@
 
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
 #include <string>
 #include <thread>
 #include "Guards.h"
@@ -56,19 +58,27 @@ protected:
 	/// Called after thread is started from startWorking().
 	virtual void startedWorking() {}
 	
-	/// Called continuously following sleep for m_idleWaitMs.
+	/// Called continuously following sleep for m_idleWaitMs, or sooner if woken with wake().
 	virtual void doWork() = 0;
 	
 	/// Called when is to be stopped, just prior to thread being joined.
 	virtual void doneWorking() {}
 
+	/// Cut short the idle wait so that doWork() is called again as soon as possible. May be called from any thread.
+	/// If the worker is busy, the next idle wait is skipped instead.
+	void wake();
+
 private:
 	std::string m_name;
 	unsigned m_idleWaitMs;
 	
 	mutable Mutex x_work;						///< Lock for the network existance.
 	std::unique_ptr<std::thread> m_work;		///< The network thread.
-	bool m_stop = false;
+	std::atomic<bool> m_stop{false};
+
+	Mutex x_idle;								///< Lock for m_woken.
+	std::condition_variable m_idle;				///< Signalled to cut short the idle wait.
+	bool m_woken = false;						///< True if there has been a wake() since the last doWork().
 };
 
 }
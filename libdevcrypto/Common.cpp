@@ -24,6 +24,9 @@
 #include <chrono>
 #include <mutex>
 #include <libdevcore/Guards.h>
+#if ETH_SECP256K1
+#include <secp256k1/secp256k1.h>
+#endif
 #include "SHA3.h"
 #include "FileSystem.h"
 #include "CryptoPP.h"
@@ -34,6 +37,16 @@ using namespace dev::crypto;
 
 static Secp256k1 s_secp256k1;
 
+#if ETH_SECP256K1
+/// Sets up libsecp256k1's tables on first use. Once that's done the library is safe to use from any number of threads
+/// without locking, unlike the CryptoPP curve.
+static void startSecp256k1()
+{
+	static bool s_started = (secp256k1_start(), true);
+	(void)s_started;
+}
+#endif
+
 bool dev::SignatureStruct::isValid()
 {
 	if (this->v > 1 ||
@@ -81,17 +94,49 @@ bool dev::decrypt(Secret const& _k, bytesConstRef _cipher, bytes& o_plaintext)
 
 Public dev::recover(Signature const& _sig, h256 const& _message)
 {
+#if ETH_SECP256K1
+	startSecp256k1();
+	byte pubkey[65];
+	int pubkeylen = 65;
+	if (_sig[64] > 1 || !secp256k1_ecdsa_recover_compact(_message.data(), 32, _sig.data(), pubkey, &pubkeylen, 0, _sig[64]) || pubkeylen != 65)
+		return Public();
+	// Skip the 0x04 uncompressed point marker.
+	return Public(&pubkey[1], Public::ConstructFromPointer);
+#else
 	return s_secp256k1.recover(_sig, _message.ref());
+#endif
 }
 
 Signature dev::sign(Secret const& _k, h256 const& _hash)
 {
+#if ETH_SECP256K1
+	startSecp256k1();
+	// Same nonce derivation as the CryptoPP path; on the off chance it's out of range (or gives an overflowing r, whose
+	// recovery id we couldn't express) just derive another.
+	for (h256 nonce = crypto::kdf(_k, _hash);; nonce = sha3(nonce))
+	{
+		if (!secp256k1_ecdsa_seckey_verify(nonce.data()))
+			continue;
+		Signature ret;
+		int v;
+		if (secp256k1_ecdsa_sign_compact(_hash.data(), 32, ret.data(), _k.data(), nonce.data(), &v) && v < 2)
+		{
+			ret[64] = (byte)v;
+			return ret;
+		}
+	}
+#else
 	return s_secp256k1.sign(_k, _hash);
+#endif
 }
 
 bool dev::verify(Public const& _p, Signature const& _s, h256 const& _hash)
 {
+#if ETH_SECP256K1
+	return !!_p && _p == recover(_s, _hash);
+#else
 	return s_secp256k1.verify(_p, _s, _hash.ref(), true);
+#endif
 }
 
 KeyPair KeyPair::create()
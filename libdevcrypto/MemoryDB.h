@@ -52,6 +52,9 @@ public:
 
 	std::set<h256> keys() const;
 
+	/// @returns true if lookups only succeed for nodes with a positive reference count. See EnforceRefs.
+	bool isEnforcingRefs() const { return m_enforceRefs; }
+
 protected:
 	std::map<h256, std::string> m_over;
 	std::map<h256, unsigned> m_refCount;
@@ -45,12 +45,28 @@ void OverlayDB::commit()
 	if (m_db)
 	{
 //		cnote << "Committing nodes to disk DB:";
+		ldb::WriteBatch batch;
+		OverlayCommitStats stats;
 		for (auto const& i: m_over)
 		{
 //			cnote << i.first << "#" << m_refCount[i.first];
 			if (m_refCount[i.first])
-				m_db->Put(m_writeOptions, ldb::Slice((char const*)i.first.data(), i.first.size), ldb::Slice(i.second.data(), i.second.size()));
+			{
+				batch.Put(ldb::Slice((char const*)i.first.data(), i.first.size), ldb::Slice(i.second.data(), i.second.size()));
+				stats.nodes++;
+				stats.bytes += i.first.size + i.second.size();
+			}
 		}
+		if (stats.nodes)
+		{
+			auto status = m_db->Write(m_writeOptions, &batch);
+			if (!status.ok())
+			{
+				cwarn << "Error committing state to disk DB:" << status.ToString();
+				BOOST_THROW_EXCEPTION(DBWriteFailed() << errinfo_comment(status.ToString()));
+			}
+		}
+		m_lastCommit = stats;
 		m_over.clear();
 		m_refCount.clear();
 	}
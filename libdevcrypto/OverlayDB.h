@@ -24,10 +24,12 @@
 #pragma warning(push)
 #pragma warning(disable: 4100 4267)
 #include <leveldb/db.h>
+#include <leveldb/write_batch.h>
 #pragma warning(pop)
 
 #include <memory>
 #include <libdevcore/Common.h>
+#include <libdevcore/Exceptions.h>
 #include <libdevcore/Log.h>
 #include "MemoryDB.h"
 namespace ldb = leveldb;
@@ -35,6 +37,15 @@ namespace ldb = leveldb;
 namespace dev
 {
 
+struct DBWriteFailed: virtual dev::Exception {};
+
+/// Amount of data flushed to the disk DB by a single OverlayDB::commit().
+struct OverlayCommitStats
+{
+	unsigned nodes = 0;
+	size_t bytes = 0;
+};
+
 class OverlayDB: public MemoryDB
 {
 public:
@@ -44,9 +55,18 @@ public:
 	ldb::DB* db() const { return m_db.get(); }
 	void setDB(ldb::DB* _db, bool _clearOverlay = true);
 
+	/// Write all live nodes of the overlay to the disk DB as a single atomic batch and clear the overlay.
+	/// @throws DBWriteFailed if the disk DB wouldn't take the batch; none of it is written and the overlay is kept.
 	void commit();
 	void rollback();
 
+	/// Have each commit() wait for the disk DB to sync its write before returning.
+	void setSyncOnCommit(bool _sync) { m_writeOptions.sync = _sync; }
+	bool isSyncOnCommit() const { return m_writeOptions.sync; }
+
+	/// @returns the number of nodes and bytes written by the last commit() that hit the disk DB.
+	OverlayCommitStats const& lastCommit() const { return m_lastCommit; }
+
 	std::string lookup(h256 _h) const;
 	bool exists(h256 _h) const;
 	void kill(h256 _h);
@@ -58,6 +78,8 @@ private:
 
 	ldb::ReadOptions m_readOptions;
 	ldb::WriteOptions m_writeOptions;
+
+	OverlayCommitStats m_lastCommit;
 };
 
 }
@@ -0,0 +1,119 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file TrieCache.cpp
+ * @date 2015
+ */
+
+#include "TrieCache.h"
+using namespace std;
+using namespace dev;
+
+TrieCache& TrieCache::get()
+{
+	static TrieCache s_cache;
+	return s_cache;
+}
+
+TrieCache::Node TrieCache::lookup(h256 const& _h)
+{
+	{
+		ReadGuard l(x_nodes);
+		auto it = m_current.find(_h);
+		if (it != m_current.end())
+		{
+			++m_hits;
+			return it->second;
+		}
+		if (!m_previous.count(_h))
+		{
+			++m_misses;
+			return Node();
+		}
+	}
+
+	// Promotion from the previous generation changes both, so needs the lock to ourselves; meanwhile someone may have
+	// promoted it already, or it may have aged out.
+	WriteGuard l(x_nodes);
+	auto it = m_current.find(_h);
+	if (it != m_current.end())
+	{
+		++m_hits;
+		return it->second;
+	}
+	it = m_previous.find(_h);
+	if (it == m_previous.end())
+	{
+		++m_misses;
+		return Node();
+	}
+	++m_hits;
+	Node ret = it->second;
+	m_previousBytes -= ret->size();
+	m_previous.erase(it);
+	m_current[_h] = ret;
+	noteInserted(ret);
+	return ret;
+}
+
+void TrieCache::insert(h256 const& _h, Node const& _n)
+{
+	WriteGuard l(x_nodes);
+	if (m_current.insert(make_pair(_h, _n)).second)
+		noteInserted(_n);
+}
+
+void TrieCache::noteInserted(Node const& _n)
+{
+	m_currentBytes += _n->size();
+	if (m_currentBytes > m_maxBytes / 2)
+	{
+		m_previous = move(m_current);
+		m_previousBytes = m_currentBytes;
+		m_current = Generation();
+		m_currentBytes = 0;
+	}
+}
+
+void TrieCache::clear()
+{
+	WriteGuard l(x_nodes);
+	m_current.clear();
+	m_previous.clear();
+	m_currentBytes = m_previousBytes = 0;
+}
+
+void TrieCache::setLimit(size_t _maxBytes)
+{
+	WriteGuard l(x_nodes);
+	m_maxBytes = _maxBytes;
+	if (m_currentBytes + m_previousBytes > m_maxBytes)
+	{
+		m_previous.clear();
+		m_previousBytes = 0;
+	}
+}
+
+TrieCacheStats TrieCache::stats() const
+{
+	ReadGuard l(x_nodes);
+	TrieCacheStats ret;
+	ret.entries = m_current.size() + m_previous.size();
+	ret.bytes = m_currentBytes + m_previousBytes;
+	ret.hits = m_hits;
+	ret.misses = m_misses;
+	return ret;
+}
@@ -0,0 +1,93 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file TrieCache.h
+ * @date 2015
+ */
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <libdevcore/Common.h>
+#include <libdevcore/FixedHash.h>
+#include <libdevcore/Guards.h>
+
+namespace dev
+{
+
+struct TrieCacheStats
+{
+	size_t entries = 0;
+	size_t bytes = 0;
+	unsigned hits = 0;
+	unsigned misses = 0;
+};
+
+/**
+ * @brief Process-wide cache of trie nodes, keyed by hash.
+ * Trie nodes are content-addressed and so immutable; they may be shared freely between tries and databases.
+ * Nodes are handed out as shared pointers, so an RLP view over one remains valid even if it is evicted meanwhile.
+ *
+ * The cache is bounded by keeping two generations: once the current one grows beyond half the limit, the previous
+ * is dropped and the current takes its place. Nodes found in the previous generation are promoted to the current.
+ * Hits in the current generation, by far the commonest lookup, take the lock only shared.
+ */
+class TrieCache
+{
+public:
+	using Node = std::shared_ptr<std::string const>;
+
+	explicit TrieCache(size_t _maxBytes = c_defaultMaxBytes): m_maxBytes(_maxBytes) {}
+
+	/// @returns the cache shared by all tries.
+	static TrieCache& get();
+
+	/// @returns the node with hash @a _h, or null if it is not cached.
+	Node lookup(h256 const& _h);
+
+	/// Cache the node @a _n, whose hash is @a _h.
+	void insert(h256 const& _h, Node const& _n);
+
+	/// Drop all cached nodes.
+	void clear();
+
+	/// Bound the total size of the node data held to around @a _maxBytes.
+	void setLimit(size_t _maxBytes);
+
+	TrieCacheStats stats() const;
+
+	static const size_t c_defaultMaxBytes = 32 * 1024 * 1024;
+
+private:
+	using Generation = std::unordered_map<h256, Node>;
+
+	/// Expects x_nodes to be held for writing.
+	void noteInserted(Node const& _n);
+
+	mutable SharedMutex x_nodes;
+	Generation m_current;
+	Generation m_previous;
+	size_t m_currentBytes = 0;
+	size_t m_previousBytes = 0;
+	size_t m_maxBytes;
+	std::atomic<unsigned> m_hits{0};		///< Counted outside the lock, so that hits need only read it.
+	std::atomic<unsigned> m_misses{0};
+};
+
+}
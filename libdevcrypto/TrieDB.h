@@ -34,6 +34,7 @@
 #include <libdevcrypto/SHA3.h>
 #include "MemoryDB.h"
 #include "OverlayDB.h"
+#include "TrieCache.h"
 #include "TrieCommon.h"
 namespace ldb = leveldb;
 
@@ -188,7 +189,7 @@ public:
 
 		struct Node
 		{
-			std::string rlp;
+			TrieCache::Node rlp;
 			std::string key;		// as hexPrefixEncoding.
 			byte child;				// 255 -> entering, 16 -> actually at the node, 17 -> exiting, 0-15 -> actual children.
 
@@ -198,7 +199,7 @@ public:
 			void setFirstChild() { child = 16; }
 			void incrementChild() { child = child == 16 ? 0 : child == 15 ? 17 : (child + 1); }
 
-			bool operator==(Node const& _c) const { return rlp == _c.rlp && key == _c.key && child == _c.child; }
+			bool operator==(Node const& _c) const { return *rlp == *_c.rlp && key == _c.key && child == _c.child; }
 			bool operator!=(Node const& _c) const { return !operator==(_c); }
 		};
 
@@ -211,6 +212,10 @@ public:
 
 	iterator lower_bound(bytesConstRef _key) const { return iterator(this, _key); }
 
+	/// @returns the RLP of the node with hash @a _h, shared through the process-wide TrieCache rather than copied.
+	/// Points to an empty string if there is no such node.
+	TrieCache::Node cachedNode(h256 _h) const;
+
 private:
 	RLPStream& streamNode(RLPStream& _s, bytes const& _b);
 
@@ -260,9 +265,9 @@ private:
 	bytes branch(RLP const& _orig);
 
 	bool isTwoItemNode(RLP const& _n) const;
-	std::string deref(RLP const& _n) const;
+	TrieCache::Node deref(RLP const& _n) const;
 
-	std::string node(h256 _h) const { return m_db->lookup(_h); }
+	std::string node(h256 _h) const { return *cachedNode(_h); }
 	void insertNode(h256 _h, bytesConstRef _v) { m_db->insert(_h, _v); }
 	void killNode(h256 _h) { m_db->kill(_h); }
 
@@ -334,14 +339,14 @@ namespace dev
 template <class DB> GenericTrieDB<DB>::iterator::iterator(GenericTrieDB const* _db)
 {
 	m_that = _db;
-	m_trail.push_back({_db->node(_db->m_root), std::string(1, '\0'), 255});	// one null byte is the HPE for the empty key.
+	m_trail.push_back({_db->cachedNode(_db->m_root), std::string(1, '\0'), 255});	// one null byte is the HPE for the empty key.
 	next();
 }
 
 template <class DB> GenericTrieDB<DB>::iterator::iterator(GenericTrieDB const* _db, bytesConstRef _fullKey)
 {
 	m_that = _db;
-	m_trail.push_back({_db->node(_db->m_root), std::string(1, '\0'), 255});	// one null byte is the HPE for the empty key.
+	m_trail.push_back({_db->cachedNode(_db->m_root), std::string(1, '\0'), 255});	// one null byte is the HPE for the empty key.
 	next(_fullKey);
 }
 
@@ -352,7 +357,7 @@ template <class DB> typename GenericTrieDB<DB>::iterator::value_type GenericTrie
 	assert(b.key.size());
 	assert(!(b.key[0] & 0x10));	// should be an integer number of bytes (i.e. not an odd number of nibbles).
 
-	RLP rlp(b.rlp);
+	RLP rlp(*b.rlp);
 	return std::make_pair(bytesConstRef(b.key).cropped(1), rlp[rlp.itemCount() == 2 ? 1 : 16].payload());
 }
 
@@ -368,7 +373,7 @@ template <class DB> void GenericTrieDB<DB>::iterator::next(NibbleSlice _key)
 		}
 
 		Node const& b = m_trail.back();
-		RLP rlp(b.rlp);
+		RLP rlp(*b.rlp);
 
 		if (m_trail.back().child == 255)
 		{
@@ -384,7 +389,7 @@ template <class DB> void GenericTrieDB<DB>::iterator::next(NibbleSlice _key)
 			{
 #if ETH_PARANOIA
 				cwarn << "BIG FAT ERROR. STATE TRIE CORRUPTED!!!!!";
-				cwarn << b.rlp.size() << toHex(b.rlp);
+				cwarn << b.rlp->size() << toHex(*b.rlp);
 				cwarn << rlp;
 				auto c = rlp.itemCount();
 				cwarn << c;
@@ -505,7 +510,7 @@ template <class DB> void GenericTrieDB<DB>::iterator::next()
 		}
 
 		Node const& b = m_trail.back();
-		RLP rlp(b.rlp);
+		RLP rlp(*b.rlp);
 
 		if (m_trail.back().child == 255)
 		{
@@ -519,7 +524,7 @@ template <class DB> void GenericTrieDB<DB>::iterator::next()
 			{
 #if ETH_PARANOIA
 				cwarn << "BIG FAT ERROR. STATE TRIE CORRUPTED!!!!!";
-				cwarn << b.rlp.size() << toHex(b.rlp);
+				cwarn << b.rlp->size() << toHex(*b.rlp);
 				cwarn << rlp;
 				auto c = rlp.itemCount();
 				cwarn << c;
@@ -630,7 +635,7 @@ template <class DB> void GenericTrieDB<DB>::insert(bytesConstRef _key, bytesCons
 
 template <class DB> std::string GenericTrieDB<DB>::at(bytesConstRef _key) const
 {
-	return atAux(RLP(node(m_root)), _key);
+	return atAux(RLP(*cachedNode(m_root)), _key);
 }
 
 template <class DB> std::string GenericTrieDB<DB>::atAux(RLP const& _here, NibbleSlice _key) const
@@ -647,7 +652,7 @@ template <class DB> std::string GenericTrieDB<DB>::atAux(RLP const& _here, Nibbl
 			return _here[1].toString();
 		else if (_key.contains(k) && !isLeaf(_here))
 			// not yet at leaf and it might yet be us. onwards...
-			return atAux(_here[1].isList() ? _here[1] : RLP(node(_here[1].toHash<h256>())), _key.mid(k.size()));
+			return atAux(_here[1].isList() ? _here[1] : RLP(*cachedNode(_here[1].toHash<h256>())), _key.mid(k.size()));
 		else
 			// not us.
 			return std::string();
@@ -660,7 +665,7 @@ template <class DB> std::string GenericTrieDB<DB>::atAux(RLP const& _here, Nibbl
 		if (n.isEmpty())
 			return std::string();
 		else
-			return atAux(n.isList() ? n : RLP(node(n.toHash<h256>())), _key.mid(1));
+			return atAux(n.isList() ? n : RLP(*cachedNode(n.toHash<h256>())), _key.mid(1));
 	}
 }
 
@@ -778,13 +783,35 @@ template <class DB> void GenericTrieDB<DB>::remove(bytesConstRef _key)
 
 template <class DB> bool GenericTrieDB<DB>::isTwoItemNode(RLP const& _n) const
 {
-	return (_n.isData() && RLP(node(_n.toHash<h256>())).itemCount() == 2)
+	return (_n.isData() && RLP(*cachedNode(_n.toHash<h256>())).itemCount() == 2)
 			|| (_n.isList() && _n.itemCount() == 2);
 }
 
-template <class DB> std::string GenericTrieDB<DB>::deref(RLP const& _n) const
+template <class DB> TrieCache::Node GenericTrieDB<DB>::deref(RLP const& _n) const
 {
-	return _n.isList() ? _n.data().toString() : node(_n.toHash<h256>());
+	return _n.isList() ? std::make_shared<std::string const>(_n.data().toString()) : cachedNode(_n.toHash<h256>());
+}
+
+template <class DB> TrieCache::Node GenericTrieDB<DB>::cachedNode(h256 _h) const
+{
+	static const TrieCache::Node s_none = std::make_shared<std::string const>();
+
+	// Reference enforcement is a property of the particular database, so it must be asked directly.
+	if (m_db->isEnforcingRefs())
+	{
+		std::string ret = m_db->lookup(_h);
+		return ret.empty() ? s_none : std::make_shared<std::string const>(std::move(ret));
+	}
+
+	TrieCache& cache = TrieCache::get();
+	if (TrieCache::Node ret = cache.lookup(_h))
+		return ret;
+	std::string n = m_db->lookup(_h);
+	if (n.empty())
+		return s_none;
+	TrieCache::Node ret = std::make_shared<std::string const>(std::move(n));
+	cache.insert(_h, ret);
+	return ret;
 }
 
 template <class DB> bytes GenericTrieDB<DB>::deleteAt(RLP const& _orig, NibbleSlice _k)
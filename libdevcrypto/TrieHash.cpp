@@ -21,49 +21,24 @@
 
 #include "TrieHash.h"
 
-#include <libdevcrypto/TrieCommon.h>
-#include <libdevcrypto/SHA3.h>
-#include <libethcore/CommonEth.h>
+#include <libdevcore/RLP.h>
+#include "TrieCommon.h"
+#include "SHA3.h"
 using namespace std;
 using namespace dev;
-using namespace dev::eth;
 
 namespace dev
 {
 
-/*/
-#define APPEND_CHILD appendData
-/*/
-#define APPEND_CHILD appendRaw
-/**/
-
-#define ENABLE_DEBUG_PRINT 0
-
-#if ENABLE_DEBUG_PRINT
-bool g_hashDebug = false;
-#endif
-
 void hash256aux(HexMap const& _s, HexMap::const_iterator _begin, HexMap::const_iterator _end, unsigned _preLen, RLPStream& _rlp);
 
 void hash256rlp(HexMap const& _s, HexMap::const_iterator _begin, HexMap::const_iterator _end, unsigned _preLen, RLPStream& _rlp)
 {
-#if ENABLE_DEBUG_PRINT
-	static std::string s_indent;
-	if (_preLen)
-		s_indent += "  ";
-#endif
-
 	if (_begin == _end)
 		_rlp << "";	// NULL
 	else if (std::next(_begin) == _end)
-	{
 		// only one left - terminate with the pair.
 		_rlp.appendList(2) << hexPrefixEncode(_begin->first, true, _preLen) << _begin->second;
-#if ENABLE_DEBUG_PRINT
-		if (g_hashDebug)
-			std::cerr << s_indent << toHex(bytesConstRef(_begin->first.data() + _preLen, _begin->first.size() - _preLen), 1) << ": " << _begin->second << " = " << sha3(_rlp.out()) << std::endl;
-#endif
-	}
 	else
 	{
 		// find the number of common prefix nibbles shared
@@ -80,16 +55,8 @@ void hash256rlp(HexMap const& _s, HexMap::const_iterator _begin, HexMap::const_i
 		if (sharedPre > _preLen)
 		{
 			// if they all have the same next nibble, we also want a pair.
-#if ENABLE_DEBUG_PRINT
-			if (g_hashDebug)
-				std::cerr << s_indent << toHex(bytesConstRef(_begin->first.data() + _preLen, sharedPre), 1) << ": " << std::endl;
-#endif
 			_rlp.appendList(2) << hexPrefixEncode(_begin->first, false, _preLen, (int)sharedPre);
 			hash256aux(_s, _begin, _end, (unsigned)sharedPre, _rlp);
-#if ENABLE_DEBUG_PRINT
-			if (g_hashDebug)
-				std::cerr << s_indent << "= " << hex << sha3(_rlp.out()) << dec << std::endl;
-#endif
 		}
 		else
 		{
@@ -97,13 +64,7 @@ void hash256rlp(HexMap const& _s, HexMap::const_iterator _begin, HexMap::const_i
 			_rlp.appendList(17);
 			auto b = _begin;
 			if (_preLen == b->first.size())
-			{
-#if ENABLE_DEBUG_PRINT
-				if (g_hashDebug)
-					std::cerr << s_indent << "@: " << b->second << std::endl;
-#endif
 				++b;
-			}
 			for (auto i = 0; i < 16; ++i)
 			{
 				auto n = b;
@@ -111,30 +72,15 @@ void hash256rlp(HexMap const& _s, HexMap::const_iterator _begin, HexMap::const_i
 				if (b == n)
 					_rlp << "";
 				else
-				{
-#if ENABLE_DEBUG_PRINT
-					if (g_hashDebug)
-						std::cerr << s_indent << std::hex << i << ": " << std::dec << std::endl;
-#endif
 					hash256aux(_s, b, n, _preLen + 1, _rlp);
-				}
 				b = n;
 			}
 			if (_preLen == _begin->first.size())
 				_rlp << _begin->second;
 			else
 				_rlp << "";
-
-#if ENABLE_DEBUG_PRINT
-			if (g_hashDebug)
-				std::cerr << s_indent << "= " << hex << sha3(_rlp.out()) << dec << std::endl;
-#endif
 		}
 	}
-#if ENABLE_DEBUG_PRINT
-	if (_preLen)
-		s_indent.resize(s_indent.size() - 2);
-#endif
 }
 
 void hash256aux(HexMap const& _s, HexMap::const_iterator _begin, HexMap::const_iterator _end, unsigned _preLen, RLPStream& _rlp)
@@ -142,20 +88,10 @@ void hash256aux(HexMap const& _s, HexMap::const_iterator _begin, HexMap::const_i
 	RLPStream rlp;
 	hash256rlp(_s, _begin, _end, _preLen, rlp);
 	if (rlp.out().size() < 32)
-	{
 		// RECURSIVE RLP
-#if ENABLE_DEBUG_PRINT
-		cerr << "[INLINE: " << dec << rlp.out().size() << " < 32]" << endl;
-#endif
-		_rlp.APPEND_CHILD(rlp.out());
-	}
+		_rlp.appendRaw(rlp.out());
 	else
-	{
-#if ENABLE_DEBUG_PRINT
-		cerr << "[HASH: " << dec << rlp.out().size() << " >= 32]" << endl;
-#endif
 		_rlp << sha3(rlp.out());
-	}
 }
 
 h256 hash256(StringMap const& _s)
@@ -197,4 +133,27 @@ h256 hash256(u256Map const& _s)
 	return sha3(s.out());
 }
 
+h256 hash256(BytesMap const& _s)
+{
+	// build patricia tree.
+	if (_s.empty())
+		return sha3(rlp(""));
+	HexMap hexMap;
+	for (auto const& i: _s)
+		hexMap.insert(hexMap.end(), make_pair(asNibbles(&i.first), asString(i.second)));
+	RLPStream s;
+	hash256rlp(hexMap, hexMap.cbegin(), hexMap.cend(), 0, s);
+	return sha3(s.out());
+}
+
+h256 orderedTrieRoot(std::vector<bytes> const& _data)
+{
+	return trieRootOver((unsigned)_data.size(), [](unsigned i) { return rlp(i); }, [&](unsigned i) { return _data[i]; });
+}
+
+h256 orderedTrieRoot(std::vector<bytesConstRef> const& _data)
+{
+	return trieRootOver((unsigned)_data.size(), [](unsigned i) { return rlp(i); }, [&](unsigned i) { return _data[i].toBytes(); });
+}
+
 }
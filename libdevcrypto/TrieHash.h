@@ -0,0 +1,56 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file TrieHash.h
+ * @author Gav Wood <i@gavwood.com>
+ * @date 2014
+ */
+
+#pragma once
+
+#include <libdevcore/Common.h>
+#include <libdevcore/FixedHash.h>
+
+namespace dev
+{
+
+/*
+ * Trie roots worked out directly from the full set of key/value pairs. The pairs are put in key order and the trie
+ * is built from the top down, so each node is encoded and hashed exactly once, rather than re-encoded and re-hashed
+ * on every insertion as when filling a GenericTrieDB. Use these when only the root is wanted.
+ */
+
+bytes rlp256(StringMap const& _s);
+h256 hash256(StringMap const& _s);
+h256 hash256(u256Map const& _s);
+h256 hash256(BytesMap const& _s);
+
+/// @returns the root of the trie of @a _itemCount items, the i-th keyed by _getKey(i) and of value _getValue(i).
+template <class _KeyOf, class _ValueOf>
+h256 trieRootOver(unsigned _itemCount, _KeyOf const& _getKey, _ValueOf const& _getValue)
+{
+	BytesMap m;
+	for (unsigned i = 0; i < _itemCount; ++i)
+		m[_getKey(i)] = _getValue(i);
+	return hash256(m);
+}
+
+/// @returns the root of the trie of @a _data keyed by the RLP of each item's index, as used for a block's
+/// transactions and receipts.
+h256 orderedTrieRoot(std::vector<bytes> const& _data);
+h256 orderedTrieRoot(std::vector<bytesConstRef> const& _data);
+
+}
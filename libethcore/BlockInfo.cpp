@@ -22,6 +22,7 @@
 #include <libdevcore/Common.h>
 #include <libdevcore/RLP.h>
 #include <libdevcrypto/TrieDB.h>
+#include <libdevcrypto/TrieHash.h>
 #include <libethcore/CommonEth.h>
 #include "ProofOfWork.h"
 #include "Exceptions.h"
@@ -149,20 +150,16 @@ void BlockInfo::verifyInternals(bytesConstRef _block) const
 
 	u256 mgp = (u256)-1;
 
-	OverlayDB db;
-	GenericTrieDB<OverlayDB> t(&db);
-	t.init();
-	unsigned i = 0;
+	vector<bytesConstRef> txs;
 	for (auto const& tr: root[1])
 	{
-		bytes k = rlp(i);
-		t.insert(&k, tr.data());
+		txs.push_back(tr.data());
 		u256 gp = tr[1].toInt<u256>();
 		mgp = min(mgp, gp);
-		++i;
 	}
-	if (transactionsRoot != t.root())
-		BOOST_THROW_EXCEPTION(InvalidTransactionsHash(t.root(), transactionsRoot));
+	h256 t = orderedTrieRoot(txs);
+	if (transactionsRoot != t)
+		BOOST_THROW_EXCEPTION(InvalidTransactionsHash(t, transactionsRoot));
 
 	if (sha3Uncles != sha3(root[2].data()))
 		BOOST_THROW_EXCEPTION(InvalidUnclesHash());
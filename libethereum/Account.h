@@ -23,6 +23,7 @@
 
 #include <libdevcore/Common.h>
 #include <libdevcore/RLP.h>
+#include <libdevcrypto/Common.h>
 #include <libdevcrypto/TrieDB.h>
 #include <libdevcrypto/SHA3.h>
 
@@ -122,8 +123,8 @@ public:
 	/// which encodes the base-state of the account's storage (upon which the storage is overlaid).
 	h256 baseRoot() const { assert(m_storageRoot); return m_storageRoot; }
 
-	/// @returns the storage overlay as a simple map.
-	std::map<u256, u256> const& storageOverlay() const { return m_storageOverlay; }
+	/// @returns the storage overlay as a hash map. It is unordered; sort the keys where order matters.
+	u256HashMap const& storageOverlay() const { return m_storageOverlay; }
 
 	/// Set a key/value pair in the account's storage. This actually goes into the overlay, for committing
 	/// to the trie later.
@@ -140,18 +141,22 @@ public:
 	h256 codeHash() const { assert(!isFreshCode()); return m_codeHash; }
 
 	/// Sets the code of the account. Must only be called when isFreshCode() returns true.
-	void setCode(bytes&& _code) { assert(isFreshCode()); m_codeCache = _code; }
-	void setCode(bytes const& _code) { assert(isFreshCode()); m_codeCache = _code; }
+	void setCode(bytes&& _code) { assert(isFreshCode()); m_codeCache = std::make_shared<bytes const>(std::move(_code)); }
+	void setCode(bytes const& _code) { assert(isFreshCode()); m_codeCache = std::make_shared<bytes const>(_code); }
 
 	/// @returns true if the account's code is available through code().
-	bool codeCacheValid() const { return m_codeHash == EmptySHA3 || m_codeHash == c_contractConceptionCodeHash || m_codeCache.size(); }
+	bool codeCacheValid() const { return m_codeHash == EmptySHA3 || m_codeHash == c_contractConceptionCodeHash || m_codeCache; }
 
 	/// Specify to the object what the actual code is for the account. @a _code must have a SHA3 equal to
-	/// codeHash() and must only be called when isFreshCode() returns false.
-	void noteCode(bytesConstRef _code) { assert(sha3(_code) == m_codeHash); m_codeCache = _code.toBytes(); }
+	/// codeHash() and must only be called when isFreshCode() returns false. The code is shared, not copied.
+	void noteCode(std::shared_ptr<bytes const> const& _code) { assert(sha3(*_code) == m_codeHash); m_codeCache = _code; }
 
 	/// @returns the account's code. Must only be called when codeCacheValid returns true.
-	bytes const& code() const { assert(codeCacheValid()); return m_codeCache; }
+	bytes const& code() const { assert(codeCacheValid()); return m_codeCache ? *m_codeCache : NullBytes; }
+
+	/// @returns the account's code as held, which may be shared with other accounts and the CodeCache. Null if
+	/// the code is empty or not yet known.
+	std::shared_ptr<bytes const> const& sharedCode() const { return m_codeCache; }
 
 private:
 	/// Is this account existant? If not, it represents a deleted account.
@@ -176,16 +181,19 @@ private:
 	h256 m_codeHash = EmptySHA3;
 
 	/// The map with is overlaid onto whatever storage is implied by the m_storageRoot in the trie.
-	std::map<u256, u256> m_storageOverlay;
+	u256HashMap m_storageOverlay;
 
 	/// The associated code for this account. The SHA3 of this should be equal to m_codeHash unless m_codeHash
-	/// equals c_contractConceptionCodeHash.
-	bytes m_codeCache;
+	/// equals c_contractConceptionCodeHash. Immutable once set, so copies of the account share it.
+	std::shared_ptr<bytes const> m_codeCache;
 
 	/// Value for m_codeHash when this account is having its code determined.
 	static const h256 c_contractConceptionCodeHash;
 };
 
+/// An address cache: the accounts at each of a number of addresses. It is unordered; sort the addresses where order matters.
+using AccountMap = std::unordered_map<Address, Account>;
+
 }
 }
 
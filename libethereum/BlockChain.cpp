@@ -21,11 +21,15 @@
 
 #include "BlockChain.h"
 
+#include <condition_variable>
+#include <future>
 #include <boost/filesystem.hpp>
 #include <test/JsonSpiritHeaders.h>
 #include <libdevcore/Common.h>
 #include <libdevcore/RLP.h>
+#include <libdevcore/ThreadPool.h>
 #include <libdevcrypto/FileSystem.h>
+#include <libdevcrypto/TrieHash.h>
 #include <libethcore/Exceptions.h>
 #include <libethcore/ProofOfWork.h>
 #include <libethcore/BlockInfo.h>
@@ -40,12 +44,17 @@ namespace js = json_spirit;
 
 #define ETH_CATCH 1
 
+/// How often the caches are garbage collected.
+static const chrono::seconds c_collectionDuration(5);
+/// How many collections an unused cache entry survives while the caches are above their minimum size.
+static const unsigned c_collectionQueueSize = 12;
+
 std::ostream& dev::eth::operator<<(std::ostream& _out, BlockChain const& _bc)
 {
 	string cmp = toBigEndianString(_bc.currentHash());
 	auto it = _bc.m_extrasDB->NewIterator(_bc.m_readOptions);
 	for (it->SeekToFirst(); it->Valid(); it->Next())
-		if (it->key().ToString() != "best")
+		if (it->key().ToString() != "best" && it->value().size() != 32)	// skip the best hash and the number index
 		{
 			string rlpString = it->value().ToString();
 			RLP r(rlpString);
@@ -103,14 +112,16 @@ bytes BlockChain::createGenesisBlock()
 {
 	RLPStream block(3);
 
-	h256 stateRoot;
+	// Only the root is wanted here; the genesis accounts bear no storage, so they go straight into the state trie.
+	BytesMap accounts;
+	for (auto const& i: genesisState())
 	{
-		MemoryDB db;
-		TrieDB<Address, MemoryDB> state(&db);
-		state.init();
-		dev::eth::commit(genesisState(), db, state);
-		stateRoot = state.root();
+		assert(i.second.storageOverlay().empty());
+		RLPStream s(4);
+		s << i.second.nonce() << i.second.balance() << EmptyTrie << (i.second.isFreshCode() ? sha3(i.second.code()) : i.second.codeHash());
+		accounts[i.first.asBytes()] = s.out();
 	}
+	h256 stateRoot = hash256(accounts);
 
 	block.appendList(14)
 		<< h256() << EmptyListSHA3 << h160() << stateRoot << EmptyTrie << EmptyTrie << LogBloom() << c_genesisDifficulty << 0 << 1000000 << 0 << (unsigned)0 << string() << sha3(bytes(1, 42));
@@ -169,6 +180,11 @@ void BlockChain::open(std::string _path, bool _killExisting)
 
 	m_lastBlockHash = l.empty() ? m_genesisHash : *(h256*)l.data();
 
+	// Databases written before the number index existed get it built here, once.
+	ldb::WriteBatch batch;
+	updateNumberIndex(m_lastBlockHash, m_lastBlockHash, batch);
+	m_extrasDB->Write(m_writeOptions, &batch);
+
 	cnote << "Opened blockchain DB. Latest: " << currentHash();
 }
 
@@ -179,7 +195,20 @@ void BlockChain::close()
 	delete m_db;
 	m_lastBlockHash = m_genesisHash;
 	m_details.clear();
+	m_logBlooms.clear();
+	m_receipts.clear();
 	m_cache.clear();
+
+	Guard l(x_cacheUsage);
+	m_cacheUsage = std::deque<CacheIDs>(1);
+	m_inUse.clear();
+	m_cacheStats = BlockChainCacheStats();
+	for (auto& u: m_cacheUses)
+	{
+		Guard l(u.x);
+		u.used.clear();
+		u.hits = u.misses = 0;
+	}
 }
 
 template <class T, class V>
@@ -208,12 +237,46 @@ h256s BlockChain::sync(BlockQueue& _bq, OverlayDB const& _stateDB, unsigned _max
 	vector<bytes> blocks;
 	_bq.drain(blocks);
 
+	// Verify the blocks on the thread pool while they're executed here in order. The pool takes them in order too,
+	// so each should be ready by the time its turn comes.
+	vector<VerifiedBlock> verified(blocks.size());
+	vector<exception_ptr> failed(blocks.size());
+	vector<bool> done(blocks.size(), false);
+	Mutex x_done;
+	condition_variable doneChanged;
+	auto verifying = async(launch::async, [&]()
+	{
+		ThreadPool::get().forEach(blocks.size(), [&](size_t i)
+		{
+			try
+			{
+				verified[i] = verifyBlock(blocks[i]);
+			}
+			catch (...)
+			{
+				failed[i] = current_exception();
+			}
+			{
+				Guard l(x_done);
+				done[i] = true;
+			}
+			doneChanged.notify_all();
+		});
+	});
+
 	h256s ret;
-	for (auto const& block: blocks)
+	for (unsigned i = 0; i < blocks.size(); ++i)
 	{
+		bytes const& block = blocks[i];
+		{
+			unique_lock<Mutex> l(x_done);
+			doneChanged.wait(l, [&](){ return done[i]; });
+		}
 		try
 		{
-			for (auto h: import(block, _stateDB))
+			if (failed[i])
+				rethrow_exception(failed[i]);
+			for (auto h: import(verified[i], _stateDB))
 				if (!_max--)
 					break;
 				else
@@ -231,7 +294,9 @@ h256s BlockChain::sync(BlockQueue& _bq, OverlayDB const& _stateDB, unsigned _max
 		}
 		catch (...)
 		{}
+		verified[i] = VerifiedBlock();
 	}
+	verifying.wait();
 	_bq.doneDrain();
 	return ret;
 }
@@ -249,17 +314,19 @@ h256s BlockChain::attemptImport(bytes const& _block, OverlayDB const& _stateDB)
 	}
 }
 
-h256s BlockChain::import(bytes const& _block, OverlayDB const& _db)
+VerifiedBlock BlockChain::verifyBlock(bytes const& _block)
 {
-	// VERIFY: populates from the block and checks the block is internally coherent.
-	BlockInfo bi;
+	VerifiedBlock ret;
 
 #if ETH_CATCH
 	try
 #endif
 	{
-		bi.populate(&_block);
-		bi.verifyInternals(&_block);
+		// VERIFY: populates from the block and checks the block is internally coherent.
+		ret.info.populate(&_block);
+		ret.info.verifyInternals(&_block);
+		for (auto const& tr: RLP(_block)[1])
+			ret.transactions.push_back(Transaction(tr.data(), true));
 	}
 #if ETH_CATCH
 	catch (Exception const& _e)
@@ -269,7 +336,19 @@ h256s BlockChain::import(bytes const& _block, OverlayDB const& _db)
 		throw;
 	}
 #endif
-	auto newHash = BlockInfo::headerHash(_block);
+	ret.block = _block;
+	return ret;
+}
+
+h256s BlockChain::import(bytes const& _block, OverlayDB const& _db)
+{
+	return import(verifyBlock(_block), _db);
+}
+
+h256s BlockChain::import(VerifiedBlock const& _block, OverlayDB const& _db)
+{
+	BlockInfo const& bi = _block.info;
+	auto newHash = bi.hash;
 
 	// Check block doesn't already exist first!
 	if (isKnown(newHash))
@@ -313,7 +392,7 @@ h256s BlockChain::import(bytes const& _block, OverlayDB const& _db)
 		// Check transactions are valid and that they result in a state equivalent to our state_root.
 		// Get total difficulty increase and update state, checking it.
 		State s(bi.coinbaseAddress, _db);
-		auto tdIncrease = s.enactOn(&_block, bi, *this);
+		auto tdIncrease = s.enactOn(_block, *this);
 		BlockLogBlooms blb;
 		BlockReceipts br;
 		for (unsigned i = 0; i < s.pending().size(); ++i)
@@ -331,7 +410,8 @@ h256s BlockChain::import(bytes const& _block, OverlayDB const& _db)
 		{
 			WriteGuard l(x_details);
 			m_details[newHash] = BlockDetails((unsigned)pd.number + 1, td, bi.parentHash, {});
-			m_details[bi.parentHash].children.push_back(newHash);
+			// The parent's entry may have been evicted since we fetched pd.
+			m_details.insert(make_pair(bi.parentHash, pd)).first->second.children.push_back(newHash);
 		}
 		{
 			WriteGuard l(x_logBlooms);
@@ -342,17 +422,27 @@ h256s BlockChain::import(bytes const& _block, OverlayDB const& _db)
 			m_receipts[newHash] = br;
 		}
 
+		noteUsed(newHash, ExtraDetails);
+		noteUsed(bi.parentHash, ExtraDetails);
+		noteUsed(newHash, ExtraLogBlooms);
+		noteUsed(newHash, ExtraReceipts);
+
 		m_extrasDB->Put(m_writeOptions, toSlice(newHash), (ldb::Slice)dev::ref(m_details[newHash].rlp()));
 		m_extrasDB->Put(m_writeOptions, toSlice(bi.parentHash), (ldb::Slice)dev::ref(m_details[bi.parentHash].rlp()));
 		m_extrasDB->Put(m_writeOptions, toSlice(newHash, 3), (ldb::Slice)dev::ref(m_logBlooms[newHash].rlp()));
 		m_extrasDB->Put(m_writeOptions, toSlice(newHash, 4), (ldb::Slice)dev::ref(m_receipts[newHash].rlp()));
-		m_db->Put(m_writeOptions, toSlice(newHash), (ldb::Slice)ref(_block));
+		m_db->Put(m_writeOptions, toSlice(newHash), (ldb::Slice)ref(_block.block));
 
 #if ETH_PARANOIA
 		checkConsistency();
 #endif
 	}
 #if ETH_CATCH
+	catch (DBWriteFailed const&)
+	{
+		// Nothing wrong with the block; its state just couldn't be written. Nothing of it is recorded, so it may be retried.
+		throw;
+	}
 	catch (Exception const& _e)
 	{
 		clog(BlockChainNote) << "   Malformed block: " << diagnostic_information(_e);
@@ -369,11 +459,17 @@ h256s BlockChain::import(bytes const& _block, OverlayDB const& _db)
 	if (td > details(last).totalDifficulty)
 	{
 		ret = treeRoute(last, newHash);
+
+		// Write the new best and its number index together, and only then make it current, so that no one sees
+		// the new head with the old fork's index (or, on disk, one without the other).
+		ldb::WriteBatch batch;
+		batch.Put(ldb::Slice("best"), ldb::Slice((char const*)&newHash, 32));
+		updateNumberIndex(last, newHash, batch);
+		m_extrasDB->Write(m_writeOptions, &batch);
 		{
 			WriteGuard l(x_lastBlockHash);
 			m_lastBlockHash = newHash;
 		}
-		m_extrasDB->Put(m_writeOptions, ldb::Slice("best"), ldb::Slice((char const*)&newHash, 32));
 		clog(BlockChainNote) << "   Imported and best" << td << ". Has" << (details(bi.parentHash).children.size() - 1) << "siblings. Route:" << toString(ret);
 	}
 	else
@@ -500,7 +596,12 @@ bytes BlockChain::block(h256 _hash) const
 		ReadGuard l(x_cache);
 		auto it = m_cache.find(_hash);
 		if (it != m_cache.end())
-			return it->second;
+		{
+			bytes ret = it->second;
+			l.unlock();
+			noteHit(_hash, ExtraBlock);
+			return ret;
+		}
 	}
 
 	string d;
@@ -512,6 +613,7 @@ bytes BlockChain::block(h256 _hash) const
 		return bytes();
 	}
 
+	noteMiss(_hash, ExtraBlock);
 	WriteGuard l(x_cache);
 	m_cache[_hash].resize(d.size());
 	memcpy(m_cache[_hash].data(), d.data(), d.size());
@@ -524,6 +626,313 @@ h256 BlockChain::numberHash(unsigned _n) const
 	if (!_n)
 		return genesisHash();
 	h256 ret = currentHash();
+	if (_n >= number(ret))
+		return ret;
+
+	string d;
+	m_extrasDB->Get(m_readOptions, toSlice(h256(u256(_n)), ExtraNumberHash), &d);
+	if (d.size() == 32)
+		return h256((byte const*)d.data(), h256::ConstructFromPointer);
+
+	// Not indexed (yet) - fall back to walking back from the head.
 	for (; _n < details().number; ++_n, ret = details(ret).parent) {}
 	return ret;
 }
+
+h256s BlockChain::ancestors(h256 _hash, unsigned _n) const
+{
+	unsigned n = number(_hash);
+	_n = min(_n, n);
+	h256s ret;
+	if (!_n)
+		return ret;
+
+	if (numberHash(n) == _hash)
+	{
+		// The number index's keys are each number xored with ExtraNumberHash, so those we want are all between the
+		// keys of the lowest (with that bit cleared) and highest (with it set). Nothing else in the DB has such keys.
+		unsigned lo = n - _n;
+		unsigned hi = n - 1;
+		ret.resize(_n);
+		unsigned found = 0;
+		if (!lo)
+		{
+			ret[hi] = genesisHash();
+			++found;
+		}
+		h256 last(u256(hi | ExtraNumberHash));
+		unique_ptr<ldb::Iterator> it(m_extrasDB->NewIterator(m_readOptions));
+		for (it->Seek(toSlice(h256(u256(lo & ~(unsigned)ExtraNumberHash)))); it->Valid(); it->Next())
+		{
+			if (it->key().size() != 32 || it->value().size() != 32)
+				continue;
+			h256 k((byte const*)it->key().data(), h256::ConstructFromPointer);
+			if (k > last)
+				break;
+			unsigned i = (unsigned)u256(k) ^ ExtraNumberHash;
+			if (i >= lo && i <= hi && i)
+			{
+				ret[hi - i] = h256((byte const*)it->value().data(), h256::ConstructFromPointer);
+				++found;
+			}
+		}
+		// The scan sees the index at a single moment, but a reorg may have rewritten it since we checked _hash was
+		// canonical; only if it still leads to _hash's parent are these its ancestors.
+		if (found == _n && ret.front() == details(_hash).parent)
+			return ret;
+		// Not (yet) fully indexed, or no longer canonical - fall back to walking.
+		ret.clear();
+	}
+
+	for (h256 p = details(_hash).parent; ret.size() < _n && p; p = details(p).parent)
+		ret.push_back(p);
+	return ret;
+}
+
+void BlockChain::withBlocks(h256s const& _hashes, function<void(vector<bytesConstRef> const&)> const& _f) const
+{
+	// Read those we haven't cached first, so as not to hold the cache lock over the DB.
+	map<h256, string> read;
+	{
+		ReadGuard l(x_cache);
+		for (auto const& h: _hashes)
+			if (h != m_genesisHash && !m_cache.count(h))
+				read[h];
+	}
+	for (auto& i: read)
+		m_db->Get(m_readOptions, ldb::Slice((char const*)&i.first, 32), &i.second);
+
+	h256s hits;
+	{
+		vector<bytesConstRef> blocks;
+		blocks.reserve(_hashes.size());
+		ReadGuard l(x_cache);
+		for (auto const& h: _hashes)
+			if (h == m_genesisHash)
+				blocks.push_back(&m_genesisBlock);
+			else if (read.count(h))
+			{
+				string const& d = read[h];
+				if (d.size())
+					blocks.push_back(bytesConstRef((byte const*)d.data(), d.size()));
+			}
+			else
+			{
+				auto it = m_cache.find(h);
+				if (it != m_cache.end())
+				{
+					blocks.push_back(&it->second);
+					hits.push_back(h);
+				}
+				else
+				{
+					// Evicted since we looked; rare enough to just go to the DB with the lock held.
+					string& d = read[h];
+					m_db->Get(m_readOptions, ldb::Slice((char const*)&h, 32), &d);
+					if (d.size())
+						blocks.push_back(bytesConstRef((byte const*)d.data(), d.size()));
+				}
+			}
+		_f(blocks);
+	}
+	for (auto const& h: hits)
+		noteHit(h, ExtraBlock);
+}
+
+void BlockChain::updateNumberIndex(h256 _oldBest, h256 _newBest, ldb::WriteBatch& o_batch)
+{
+	unsigned n = number(_newBest);
+
+	// Numbers beyond the new head belonged to the old canonical chain only.
+	for (unsigned i = number(_oldBest); i > n; --i)
+		o_batch.Delete(toSlice(h256(u256(i)), ExtraNumberHash));
+
+	for (h256 h = _newBest; n; h = details(h).parent, --n)
+	{
+		string d;
+		m_extrasDB->Get(m_readOptions, toSlice(h256(u256(n)), ExtraNumberHash), &d);
+		if (d.size() == 32 && h256((byte const*)d.data(), h256::ConstructFromPointer) == h)
+			break;
+		o_batch.Put(toSlice(h256(u256(n)), ExtraNumberHash), ldb::Slice((char const*)&h, 32));
+	}
+}
+
+/// The caches, in the order of BlockChainCacheStats.
+static const unsigned c_caches[] = { ExtraBlock, ExtraDetails, ExtraLogBlooms, ExtraReceipts };
+
+static CacheStats& statsOf(BlockChainCacheStats& _s, unsigned _cache)
+{
+	switch (_cache)
+	{
+	case ExtraDetails: return _s.details;
+	case ExtraLogBlooms: return _s.logBlooms;
+	case ExtraReceipts: return _s.receipts;
+	default: return _s.blocks;
+	}
+}
+
+BlockChain::CacheUse& BlockChain::cacheUse(unsigned _cache) const
+{
+	switch (_cache)
+	{
+	case ExtraDetails: return m_cacheUses[1];
+	case ExtraLogBlooms: return m_cacheUses[2];
+	case ExtraReceipts: return m_cacheUses[3];
+	default: return m_cacheUses[0];
+	}
+}
+
+void BlockChain::noteUsed(h256 const& _h, unsigned _cache) const
+{
+	CacheUse& u = cacheUse(_cache);
+	Guard l(u.x);
+	u.used.insert(_h);
+}
+
+void BlockChain::noteHit(h256 const& _h, unsigned _cache) const
+{
+	CacheUse& u = cacheUse(_cache);
+	Guard l(u.x);
+	u.hits++;
+	u.used.insert(_h);
+}
+
+void BlockChain::noteMiss(h256 const& _h, unsigned _cache) const
+{
+	CacheUse& u = cacheUse(_cache);
+	Guard l(u.x);
+	u.misses++;
+	u.used.insert(_h);
+}
+
+BlockChainCacheStats BlockChain::cacheStats() const
+{
+	BlockChainCacheStats ret;
+	{
+		Guard l(x_cacheUsage);
+		ret = m_cacheStats;
+	}
+	for (unsigned c: c_caches)
+	{
+		CacheUse& u = cacheUse(c);
+		Guard l(u.x);
+		statsOf(ret, c).hits = u.hits;
+		statsOf(ret, c).misses = u.misses;
+	}
+	return ret;
+}
+
+void BlockChain::touch(CacheID const& _id) const
+{
+	auto it = m_inUse.find(_id);
+	if (it == m_inUse.end())
+		m_inUse.insert(make_pair(_id, m_generation));
+	else if (it->second != m_generation)
+		it->second = m_generation;
+	else
+		return;
+	m_cacheUsage.front().push_back(_id);
+}
+
+template <class T> static size_t memoryOf(T const& _t) { return _t.memory(); }
+static size_t memoryOf(bytes const& _b) { return sizeof(bytes) + _b.size(); }
+
+template <class T> static void measure(std::map<h256, T> const& _m, SharedMutex& _x, CacheStats& o_s)
+{
+	ReadGuard l(_x);
+	o_s.entries = _m.size();
+	o_s.bytes = 0;
+	for (auto const& i: _m)
+		o_s.bytes += sizeof(i) + memoryOf(i.second);
+}
+
+template <class T> static size_t evictFrom(std::map<h256, T>& _m, h256 const& _h, CacheStats& io_s)
+{
+	auto it = _m.find(_h);
+	if (it == _m.end())
+		return 0;
+	size_t ret = sizeof(*it) + memoryOf(it->second);
+	_m.erase(it);
+	io_s.entries--;
+	io_s.bytes -= min(io_s.bytes, ret);
+	io_s.evictions++;
+	return ret;
+}
+
+void BlockChain::updateCacheStats()
+{
+	measure(m_cache, x_cache, m_cacheStats.blocks);
+	measure(m_details, x_details, m_cacheStats.details);
+	measure(m_logBlooms, x_logBlooms, m_cacheStats.logBlooms);
+	measure(m_receipts, x_receipts, m_cacheStats.receipts);
+}
+
+size_t BlockChain::evict(CacheIDs const& _ids, unsigned _generation)
+{
+	WriteGuard l1(x_cache);
+	WriteGuard l2(x_details);
+	WriteGuard l3(x_logBlooms);
+	WriteGuard l4(x_receipts);
+	size_t ret = 0;
+	for (CacheID const& id: _ids)
+	{
+		auto it = m_inUse.find(id);
+		if (it == m_inUse.end() || it->second > _generation)
+			continue;
+		m_inUse.erase(it);
+		switch (id.second)
+		{
+		case ExtraDetails: ret += evictFrom(m_details, id.first, m_cacheStats.details); break;
+		case ExtraLogBlooms: ret += evictFrom(m_logBlooms, id.first, m_cacheStats.logBlooms); break;
+		case ExtraReceipts: ret += evictFrom(m_receipts, id.first, m_cacheStats.receipts); break;
+		case ExtraBlock: ret += evictFrom(m_cache, id.first, m_cacheStats.blocks); break;
+		}
+	}
+	return ret;
+}
+
+void BlockChain::garbageCollect(bool _force)
+{
+	auto now = chrono::steady_clock::now();
+	if (!_force && now < m_lastCollection + c_collectionDuration)
+		return;
+	m_lastCollection = now;
+
+	Guard l(x_cacheUsage);
+	// Tag whatever's been used since last time as of the generation now ending.
+	for (unsigned c: c_caches)
+	{
+		std::unordered_set<h256> used;
+		{
+			CacheUse& u = cacheUse(c);
+			Guard l(u.x);
+			swap(used, u.used);
+		}
+		for (auto const& h: used)
+			touch(CacheID(h, c));
+	}
+	updateCacheStats();
+	size_t total = m_cacheStats.bytes();
+
+	// Start a new generation; anything used from here on is younger than what's already tracked.
+	m_cacheUsage.push_front(CacheIDs());
+	++m_generation;
+
+	// Drop generations, oldest first, while over budget; those that have gone unused for a while go if above the minimum.
+	while (m_cacheUsage.size() > 1 && (total > m_maxCacheSize || (m_cacheUsage.size() > c_collectionQueueSize && total > m_minCacheSize)))
+	{
+		size_t freed = evict(m_cacheUsage.back(), m_generation - (unsigned)m_cacheUsage.size() + 1);
+		total -= min(total, freed);
+		m_cacheUsage.pop_back();
+	}
+
+	// Otherwise just fold the oldest generation into the next one.
+	if (m_cacheUsage.size() > c_collectionQueueSize)
+	{
+		CacheIDs& next = m_cacheUsage[m_cacheUsage.size() - 2];
+		next.insert(next.end(), m_cacheUsage.back().begin(), m_cacheUsage.back().end());
+		m_cacheUsage.pop_back();
+	}
+
+	clog(BlockChainChat) << "Cache usage:" << total << "bytes;" << m_inUse.size() << "entries tracked.";
+}
@@ -24,9 +24,14 @@
 #pragma warning(push)
 #pragma warning(disable: 4100 4267)
 #include <leveldb/db.h>
+#include <leveldb/write_batch.h>
 #pragma warning(pop)
 
+#include <deque>
+#include <array>
+#include <chrono>
 #include <mutex>
+#include <unordered_set>
 #include <libdevcore/Log.h>
 #include <libdevcore/Exceptions.h>
 #include <libethcore/CommonEth.h>
@@ -34,6 +39,7 @@
 #include <libdevcore/Guards.h>
 #include "BlockDetails.h"
 #include "Account.h"
+#include "Transaction.h"
 #include "BlockQueue.h"
 namespace ldb = leveldb;
 
@@ -61,10 +67,50 @@ std::map<Address, Account> const& genesisState();
 
 ldb::Slice toSlice(h256 _h, unsigned _sub = 0);
 
+/// Sub-indices of the extras DB. Those that are cached double as identifiers of their cache.
+enum ExtraIndex: unsigned
+{
+	ExtraDetails = 0,
+	ExtraNumberHash = 1,
+	ExtraLogBlooms = 3,
+	ExtraReceipts = 4,
+	ExtraBlock = (unsigned)-1	///< Not in the extras DB; identifies the block cache.
+};
+
+/// Effectiveness and (estimated) memory usage of one of the BlockChain caches.
+struct CacheStats
+{
+	size_t entries = 0;
+	size_t bytes = 0;
+	unsigned hits = 0;
+	unsigned misses = 0;
+	unsigned evictions = 0;
+};
+
+struct BlockChainCacheStats
+{
+	CacheStats blocks;
+	CacheStats details;
+	CacheStats logBlooms;
+	CacheStats receipts;
+
+	size_t bytes() const { return blocks.bytes + details.bytes + logBlooms.bytes + receipts.bytes; }
+};
+
+/**
+ * @brief A block that has passed every check that needs neither the chain nor the state: its header (including the
+ * proof-of-work), transactions root and uncles hash. Its transactions are decoded with their senders recovered.
+ */
+struct VerifiedBlock
+{
+	BlockInfo info;
+	bytes block;
+	Transactions transactions;
+};
+
 /**
  * @brief Implements the blockchain database. All data this gives is disk-backed.
  * @threadsafe
- * @todo Make not memory hog (should actually act as a cache and deallocate old entries).
  */
 class BlockChain
 {
@@ -75,11 +121,19 @@ public:
 
 	void reopen(std::string _path, bool _killExisting = false) { close(); open(_path, _killExisting); }
 
-	/// (Potentially) renders invalid existing bytesConstRef returned by lastBlock.
-	/// To be called from main loop every 100ms or so.
-	void process();
+	/// Evict the least recently used entries from the caches so they stay within their byte budget.
+	/// Does nothing until a collection is due unless @a _force is true. To be called from main loop every 100ms or so.
+	void garbageCollect(bool _force = false);
+
+	/// Set the byte budget of the caches. Entries unused for a while are evicted while the caches take more
+	/// than @a _min bytes; once over @a _max bytes the least recently used go regardless of age.
+	void setCacheLimits(size_t _min, size_t _max) { Guard l(x_cacheUsage); m_minCacheSize = _min; m_maxCacheSize = _max; }
+
+	/// @returns the hit/miss/eviction counters of the caches along with their size as of the last collection.
+	BlockChainCacheStats cacheStats() const;
 
 	/// Sync the chain with any incoming blocks. All blocks should, if processed in order
+	/// The blocks are verified in parallel ahead of their (necessarily sequential) execution.
 	h256s sync(BlockQueue& _bq, OverlayDB const& _stateDB, unsigned _max);
 
 	/// Attempt to import the given block directly into the BlockChain and sync with the state DB.
@@ -90,6 +144,14 @@ public:
 	/// @returns the block hashes of any blocks that came into/went out of the canonical block chain.
 	h256s import(bytes const& _block, OverlayDB const& _stateDB);
 
+	/// Import a block already checked with verifyBlock() into disk-backed DB.
+	/// @returns the block hashes of any blocks that came into/went out of the canonical block chain.
+	h256s import(VerifiedBlock const& _block, OverlayDB const& _stateDB);
+
+	/// Conduct all checks on @a _block that need neither the chain nor the state, and recover its transactions' senders.
+	/// May be called from any thread. @throws if the block is invalid.
+	static VerifiedBlock verifyBlock(bytes const& _block);
+
 	/// Returns true if the given block is known (though not necessarily a part of the canon chain).
 	bool isKnown(h256 _hash) const;
 
@@ -98,15 +160,15 @@ public:
 	BlockInfo info() const { return BlockInfo(block()); }
 
 	/// Get the familial details concerning a block (or the most recent mined if none given). Thread-safe.
-	BlockDetails details(h256 _hash) const { return queryExtras<BlockDetails, 0>(_hash, m_details, x_details, NullBlockDetails); }
+	BlockDetails details(h256 _hash) const { return queryExtras<BlockDetails, ExtraDetails>(_hash, m_details, x_details, NullBlockDetails); }
 	BlockDetails details() const { return details(currentHash()); }
 
 	/// Get the transactions' log blooms of a block (or the most recent mined if none given). Thread-safe.
-	BlockLogBlooms logBlooms(h256 _hash) const { return queryExtras<BlockLogBlooms, 3>(_hash, m_logBlooms, x_logBlooms, NullBlockLogBlooms); }
+	BlockLogBlooms logBlooms(h256 _hash) const { return queryExtras<BlockLogBlooms, ExtraLogBlooms>(_hash, m_logBlooms, x_logBlooms, NullBlockLogBlooms); }
 	BlockLogBlooms logBlooms() const { return logBlooms(currentHash()); }
 
 	/// Get the transactions' receipts of a block (or the most recent mined if none given). Thread-safe.
-	BlockReceipts receipts(h256 _hash) const { return queryExtras<BlockReceipts, 4>(_hash, m_receipts, x_receipts, NullBlockReceipts); }
+	BlockReceipts receipts(h256 _hash) const { return queryExtras<BlockReceipts, ExtraReceipts>(_hash, m_receipts, x_receipts, NullBlockReceipts); }
 	BlockReceipts receipts() const { return receipts(currentHash()); }
 
 	/// Get a block (RLP format) for the given hash (or the most recent mined if none given). Thread-safe.
@@ -123,9 +185,17 @@ public:
 	/// Get the hash of the genesis block. Thread-safe.
 	h256 genesisHash() const { return m_genesisHash; }
 
-	/// Get the hash of a block of a given number. Slow; try not to use it too much.
+	/// Get the hash of the canonical block of a given number. Thread-safe.
 	h256 numberHash(unsigned _n) const;
 
+	/// Get the hashes of up to @a _n ancestors of block @a _hash, parent first. If @a _hash is on the canonical chain
+	/// they're read in a single scan of the number index rather than by walking back through each block's details.
+	h256s ancestors(h256 _hash, unsigned _n) const;
+
+	/// Call @a _f with the RLP of each of the blocks @a _hashes that we have, in order. The RLP isn't copied out of the
+	/// cache or DB read buffer, and is valid only during the call; @a _f must not call back into the BlockChain.
+	void withBlocks(h256s const& _hashes, std::function<void(std::vector<bytesConstRef> const&)> const& _f) const;
+
 	/// Get all blocks not allowed as uncles given a parent (i.e. featured as uncles/main in parent, parent + 1, ... parent + 5).
 	/// @returns set including the header-hash of every parent (including @a _parent) up to and including generation +5
 	/// togther with all their quoted uncles.
@@ -164,7 +234,12 @@ private:
 			ReadGuard l(_x);
 			auto it = _m.find(_h);
 			if (it != _m.end())
-				return it->second;
+			{
+				T ret = it->second;
+				l.unlock();
+				noteHit(_h, N);
+				return ret;
+			}
 		}
 
 		std::string s;
@@ -175,6 +250,7 @@ private:
 			return _n;
 		}
 
+		noteMiss(_h, N);
 		WriteGuard l(_x);
 		auto ret = _m.insert(std::make_pair(_h, T(RLP(s))));
 		return ret.first->second;
@@ -182,6 +258,39 @@ private:
 
 	void checkConsistency();
 
+	using CacheID = std::pair<h256, unsigned>;
+	using CacheIDs = std::vector<CacheID>;
+
+	/// Uses of one cache's entries since the last collection, along with its lookup counters. Each cache has its own,
+	/// so that readers never wait on x_cacheUsage (or a collection) and those of different caches don't contend.
+	struct CacheUse
+	{
+		Mutex x;
+		std::unordered_set<h256> used;
+		unsigned hits = 0;
+		unsigned misses = 0;
+	};
+
+	/// Record a use of the entry @a _h of cache @a _cache (one of ExtraIndex) so it is kept over less recently used ones.
+	void noteUsed(h256 const& _h, unsigned _cache) const;
+	/// As noteUsed, also counting a lookup that was served from (noteHit) or had to go to (noteMiss) the disk DB.
+	void noteHit(h256 const& _h, unsigned _cache) const;
+	void noteMiss(h256 const& _h, unsigned _cache) const;
+	CacheUse& cacheUse(unsigned _cache) const;
+	/// Tag the entry @a _id as used in the current generation. Expects x_cacheUsage to be held.
+	void touch(CacheID const& _id) const;
+
+	/// Recalculate the entry count and memory usage of each cache. Expects x_cacheUsage to be held.
+	void updateCacheStats();
+	/// Evict each of @a _ids not used since @a _generation. Expects x_cacheUsage to be held.
+	/// @returns the (estimated) number of bytes freed.
+	size_t evict(CacheIDs const& _ids, unsigned _generation);
+
+	/// Add to @a o_batch the rewrite of the number->hash index of the canonical chain after the best block changed from
+	/// @a _oldBest to @a _newBest. Walks back from @a _newBest only as far as the common ancestor, so it also (re)builds
+	/// a missing index.
+	void updateNumberIndex(h256 _oldBest, h256 _newBest, ldb::WriteBatch& o_batch);
+
 	/// The caches of the disk DB and their locks.
 	mutable boost::shared_mutex x_details;
 	mutable BlockDetailsHash m_details;
@@ -192,6 +301,20 @@ private:
 	mutable boost::shared_mutex x_cache;
 	mutable std::map<h256, bytes> m_cache;
 
+	/// Usage tracking for the caches above. Uses are gathered in m_cacheUses, one for each cache, and applied at
+	/// each collection: each entry used is tagged in m_inUse with the generation in which it was last used and listed
+	/// in the matching element of m_cacheUsage (most recent first). Entries listed in an older generation than their
+	/// tag are stale and ignored on eviction.
+	mutable std::array<CacheUse, 4> m_cacheUses;
+	mutable Mutex x_cacheUsage;
+	mutable std::deque<CacheIDs> m_cacheUsage = std::deque<CacheIDs>(1);
+	mutable std::map<CacheID, unsigned> m_inUse;
+	unsigned m_generation = 0;
+	mutable BlockChainCacheStats m_cacheStats;
+	size_t m_minCacheSize = 16 * 1024 * 1024;
+	size_t m_maxCacheSize = 64 * 1024 * 1024;
+	std::chrono::steady_clock::time_point m_lastCollection;
+
 	/// The disk DBs. Thread-safe, so no need for locks.
 	ldb::DB* m_db;
 	ldb::DB* m_extrasDB;
@@ -38,3 +38,12 @@ bytes BlockDetails::rlp() const
 {
 	return rlpList(number, totalDifficulty, parent, children);
 }
+
+size_t BlockReceipts::memory() const
+{
+	size_t ret = sizeof(BlockReceipts) + receipts.size() * sizeof(TransactionReceipt);
+	for (TransactionReceipt const& r: receipts)
+		for (LogEntry const& l: r.log())
+			ret += sizeof(LogEntry) + l.topics.size() * sizeof(h256) + l.data.size();
+	return ret;
+}
@@ -46,6 +46,9 @@ struct BlockDetails
 	bool isNull() const { return !totalDifficulty; }
 	explicit operator bool() const { return !isNull(); }
 
+	/// @returns an estimate of the memory taken by this when cached.
+	size_t memory() const { return sizeof(BlockDetails) + children.size() * sizeof(h256); }
+
 	unsigned number;			// TODO: remove?
 	u256 totalDifficulty;
 	h256 parent;
@@ -57,6 +60,7 @@ struct BlockLogBlooms
 	BlockLogBlooms() {}
 	BlockLogBlooms(RLP const& _r) { blooms = _r.toVector<h512>(); }
 	bytes rlp() const { RLPStream s; s << blooms; return s.out(); }
+	size_t memory() const { return sizeof(BlockLogBlooms) + blooms.size() * sizeof(h512); }
 
 	h512s blooms;
 };
@@ -66,6 +70,7 @@ struct BlockReceipts
 	BlockReceipts() {}
 	BlockReceipts(RLP const& _r) { for (auto const& i: _r) receipts.emplace_back(i.data()); }
 	bytes rlp() const { RLPStream s(receipts.size()); for (TransactionReceipt const& i: receipts) i.streamRLP(s); return s.out(); }
+	size_t memory() const;
 
 	TransactionReceipts receipts;
 };
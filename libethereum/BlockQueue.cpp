@@ -142,4 +142,6 @@ void BlockQueue::noteReadyWithoutWriteGuard(h256 _good)
 		}
 		m_unknown.erase(r.first, r.second);
 	}
+	if (m_onReady)
+		m_onReady();
 }
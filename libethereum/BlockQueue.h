@@ -21,6 +21,7 @@
 
 #pragma once
 
+#include <functional>
 #include <boost/thread.hpp>
 #include <libdevcore/Common.h>
 #include <libdevcore/Log.h>
@@ -80,6 +81,10 @@ public:
 	/// Return first block with an unknown parent.
 	h256 firstUnknown() const { ReadGuard l(m_lock); return m_unknownSet.size() ? *m_unknownSet.begin() : h256(); }
 
+	/// Register a handler called whenever blocks become ready for import.
+	/// It is called with the queue locked, so it must be quick and must not call back into the queue.
+	void onReady(std::function<void()> const& _t) { m_onReady = _t; }
+
 private:
 	void noteReadyWithoutWriteGuard(h256 _b);
 	void notePresentWithoutWriteGuard(bytesConstRef _block);
@@ -91,6 +96,7 @@ private:
 	std::set<h256> m_unknownSet;							///< Set of all blocks whose parents are not ready/in-chain.
 	std::multimap<h256, std::pair<h256, bytes>> m_unknown;	///< For transactions that have an unknown parent; we map their parent hash to the block stuff, and insert once the block appears.
 	std::multimap<unsigned, bytes> m_future;				///< Set of blocks that are not yet valid.
+	std::function<void()> m_onReady;						///< Called when blocks become ready for import.
 };
 
 }
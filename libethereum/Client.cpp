@@ -60,13 +60,16 @@ void VersionChecker::setOk()
 }
 
 Client::Client(p2p::Host* _extNet, std::string const& _dbPath, bool _forceClean, u256 _networkId):
-	Worker("eth"),
+	Worker("eth", 1000),
 	m_vc(_dbPath),
 	m_bc(_dbPath, !m_vc.ok() || _forceClean),
 	m_stateDB(State::openDB(_dbPath, !m_vc.ok() || _forceClean)),
 	m_preMine(Address(), m_stateDB),
 	m_postMine(Address(), m_stateDB)
 {
+	// Rather than polling, work as soon as there's something new; the idle wait is only a backstop.
+	m_bq.onReady([=](){ this->wake(); });
+	m_tq.onReady([=](){ this->wake(); });
 	m_host = _extNet->registerCapability(new EthereumHost(m_bc, m_tq, m_bq, _networkId));
 
 	setMiningThreads();
@@ -463,8 +466,6 @@ void Client::inject(bytesConstRef _rlp)
 
 void Client::doWork()
 {
-	// TODO: Use condition variable rather than polling.
-
 	cworkin << "WORK";
 	h256Set changeds;
 
@@ -499,6 +500,7 @@ void Client::doWork()
 	//   all blocks.
 	// Resynchronise state with block chain & trans
 	bool rsm = false;
+	unique_ptr<State> resnapshot;
 	{
 		WriteGuard l(x_stateDB);
 		cwork << "BQ ==> CHAIN ==> STATE";
@@ -514,10 +516,15 @@ void Client::doWork()
 		x_stateDB.lock();
 		if (newBlocks.size())
 			m_stateDB = db;
+		m_bc.garbageCollect();
 
 		cwork << "preSTATE <== CHAIN";
 		if (m_preMine.sync(m_bc) || m_postMine.address() != m_preMine.address())
 		{
+			// The snapshot may need rewriting for the new head; that's slow, so it's done once we've let go of x_stateDB.
+			// Usually there's no snapshot, or it's kept up by each block, so the State needn't be copied.
+			if (m_preMine.isSnapshotStale())
+				resnapshot.reset(new State(m_preMine));
 			if (isMining())
 				cnote << "New block on chain: Restarting mining operation.";
 			m_postMine = m_preMine;
@@ -540,6 +547,9 @@ void Client::doWork()
 			rsm = true;
 		}
 	}
+	if (resnapshot && resnapshot->syncSnapshot())
+		cnote << "Rewrote the state snapshot for the new chain head.";
+
 	if (rsm)
 	{
 		ReadGuard l(x_miners);
@@ -550,8 +560,6 @@ void Client::doWork()
 	cwork << "noteChanged" << changeds.size() << "items";
 	noteChanged(changeds);
 	cworkout << "WORK";
-
-	this_thread::sleep_for(chrono::milliseconds(100));
 }
 
 unsigned Client::numberOf(int _n) const
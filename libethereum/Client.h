@@ -285,6 +285,7 @@ private:
 
 	/// Overrides for being a mining host.
 	virtual void setupState(State& _s);
+	virtual void onComplete() { wake(); }
 	virtual bool turbo() const { return m_turboMining; }
 	virtual bool force() const { return m_forceMining; }
 
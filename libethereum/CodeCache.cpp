@@ -0,0 +1,103 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file CodeCache.cpp
+ * @date 2015
+ */
+
+#include "CodeCache.h"
+using namespace std;
+using namespace dev;
+using namespace dev::eth;
+
+CodeCache& CodeCache::get()
+{
+	static CodeCache s_cache;
+	return s_cache;
+}
+
+CodeCache::Code CodeCache::lookup(h256 const& _h)
+{
+	Guard l(x_code);
+	auto it = m_current.find(_h);
+	if (it != m_current.end())
+	{
+		++m_hits;
+		return it->second;
+	}
+	it = m_previous.find(_h);
+	if (it == m_previous.end())
+	{
+		++m_misses;
+		return Code();
+	}
+	++m_hits;
+	Code ret = it->second;
+	m_previousBytes -= ret->size();
+	m_previous.erase(it);
+	m_current[_h] = ret;
+	noteInserted(ret);
+	return ret;
+}
+
+void CodeCache::insert(h256 const& _h, Code const& _c)
+{
+	Guard l(x_code);
+	if (m_current.insert(make_pair(_h, _c)).second)
+		noteInserted(_c);
+}
+
+void CodeCache::noteInserted(Code const& _c)
+{
+	m_currentBytes += _c->size();
+	if (m_currentBytes > m_maxBytes / 2)
+	{
+		m_previous = move(m_current);
+		m_previousBytes = m_currentBytes;
+		m_current = Generation();
+		m_currentBytes = 0;
+	}
+}
+
+void CodeCache::clear()
+{
+	Guard l(x_code);
+	m_current.clear();
+	m_previous.clear();
+	m_currentBytes = m_previousBytes = 0;
+}
+
+void CodeCache::setLimit(size_t _maxBytes)
+{
+	Guard l(x_code);
+	m_maxBytes = _maxBytes;
+	if (m_currentBytes + m_previousBytes > m_maxBytes)
+	{
+		m_previous.clear();
+		m_previousBytes = 0;
+	}
+}
+
+CodeCacheStats CodeCache::stats() const
+{
+	Guard l(x_code);
+	CodeCacheStats ret;
+	ret.entries = m_current.size() + m_previous.size();
+	ret.bytes = m_currentBytes + m_previousBytes;
+	ret.hits = m_hits;
+	ret.misses = m_misses;
+	return ret;
+}
@@ -0,0 +1,92 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file CodeCache.h
+ * @date 2015
+ */
+
+#pragma once
+
+#include <memory>
+#include <unordered_map>
+#include <libdevcore/Common.h>
+#include <libdevcore/FixedHash.h>
+#include <libdevcore/Guards.h>
+
+namespace dev
+{
+namespace eth
+{
+
+struct CodeCacheStats
+{
+	size_t entries = 0;
+	size_t bytes = 0;
+	unsigned hits = 0;
+	unsigned misses = 0;
+};
+
+/**
+ * @brief Process-wide store of contract code, keyed by code hash.
+ * Code is immutable and content-addressed, so one store serves every State and database. Code is handed out as a
+ * shared pointer; Accounts hold on to it directly, so it stays valid even if it is evicted meanwhile.
+ *
+ * Size is bounded as in TrieCache: by two generations, the current replacing the previous once it grows beyond half
+ * the limit. Code found in the previous generation is promoted to the current.
+ */
+class CodeCache
+{
+public:
+	using Code = std::shared_ptr<bytes const>;
+
+	explicit CodeCache(size_t _maxBytes = c_defaultMaxBytes): m_maxBytes(_maxBytes) {}
+
+	/// @returns the store shared by all States.
+	static CodeCache& get();
+
+	/// @returns the code with hash @a _h, or null if it is not cached.
+	Code lookup(h256 const& _h);
+
+	/// Cache the code @a _c, whose hash is @a _h.
+	void insert(h256 const& _h, Code const& _c);
+
+	/// Drop all cached code.
+	void clear();
+
+	/// Bound the total size of the code held to around @a _maxBytes.
+	void setLimit(size_t _maxBytes);
+
+	CodeCacheStats stats() const;
+
+	static const size_t c_defaultMaxBytes = 16 * 1024 * 1024;
+
+private:
+	using Generation = std::unordered_map<h256, Code>;
+
+	void noteInserted(Code const& _c);
+
+	mutable Mutex x_code;
+	Generation m_current;
+	Generation m_previous;
+	size_t m_currentBytes = 0;
+	size_t m_previousBytes = 0;
+	size_t m_maxBytes;
+	unsigned m_hits = 0;
+	unsigned m_misses = 0;
+};
+
+}
+}
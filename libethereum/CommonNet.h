@@ -47,6 +47,7 @@ static const unsigned c_maxHashesAsk = 256;		///< Maximum number of hashes GetBl
 static const unsigned c_maxBlocks = 128;		///< Maximum number of blocks Blocks will ever send.
 static const unsigned c_maxBlocksAsk = 128;		///< Maximum number of blocks we ask to receive in Blocks (when using GetChain).
 #endif
+static const unsigned c_maxKnownTransactions = 4096;	///< Maximum number of transaction hashes remembered as known to a peer between sends.
 
 class BlockChain;
 class TransactionQueue;
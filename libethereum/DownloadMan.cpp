@@ -24,6 +24,15 @@ using namespace std;
 using namespace dev;
 using namespace dev::eth;
 
+/// How long we'd like each fetch to take; a peer is given as many blocks as it's shown it can deliver in this time.
+static const double c_fetchTarget = 2.0;
+/// Fewest blocks we'll ask for at once, however slow the peer.
+static const unsigned c_minFetch = 4;
+/// A fetch is overdue once it has taken this many times the peer's usual...
+static const double c_overdueFactor = 4.0;
+/// ...but never before this many seconds.
+static const double c_minOverdue = 10.0;
+
 DownloadSub::DownloadSub(DownloadMan& _man): m_man(&_man)
 {
 	WriteGuard l(m_man->x_subs);
@@ -43,19 +52,26 @@ h256Set DownloadSub::nextFetch(unsigned _n)
 {
 	Guard l(m_fetch);
 
-	if (m_remaining.size())
+	if (m_remaining.size() && !m_released)
 		return m_remaining;
 
+	if (!m_released)
+		noteFetched();
+
 	m_asked.clear();
 	m_indices.clear();
 	m_remaining.clear();
+	m_released = false;
 
 	if (!m_man || m_man->chain().empty())
 		return h256Set();
 
-	m_asked = (~(m_man->taken() + m_attempted)).lowest(_n);
+	// Size the fetch to what this peer has shown it can deliver; an unmeasured peer starts on a quarter.
+	unsigned n = m_latency ? min<unsigned>(_n, max<unsigned>(c_minFetch, m_rate * c_fetchTarget)) : max<unsigned>(1, _n / 4);
+
+	m_asked = (~(m_man->taken() + m_attempted)).lowest(n);
 	if (m_asked.empty())
-		m_asked = (~(m_man->taken(true) + m_attempted)).lowest(_n);
+		m_asked = (~(m_man->taken(true) + m_attempted)).lowest(n);
 	m_attempted += m_asked;
 	for (auto i: m_asked)
 	{
@@ -63,6 +79,8 @@ h256Set DownloadSub::nextFetch(unsigned _n)
 		m_remaining.insert(x);
 		m_indices[x] = i;
 	}
+	m_fetchStarted = chrono::steady_clock::now();
+	m_fetchReceived = 0;
 	return m_remaining;
 }
 
@@ -73,5 +91,37 @@ bool DownloadSub::noteBlock(h256 _hash)
 		m_man->m_blocksGot += m_indices[_hash];
 	bool ret = !!m_remaining.count(_hash);
 	m_remaining.erase(_hash);
+	if (ret)
+		++m_fetchReceived;
 	return ret;
 }
+
+void DownloadSub::noteFetched()
+{
+	if (m_indices.empty())
+		return;
+	// Floored so that even an instant fetch counts as measured.
+	double took = max(0.001, chrono::duration<double>(chrono::steady_clock::now() - m_fetchStarted).count());
+	double rate = m_fetchReceived / took;
+	m_rate = m_rate ? (m_rate * 3 + rate) / 4 : rate;
+	m_latency = m_latency ? (m_latency * 3 + took) / 4 : took;
+}
+
+bool DownloadSub::isOverdue(chrono::steady_clock::time_point _now) const
+{
+	Guard l(m_fetch);
+	if (m_remaining.empty() || m_released)
+		return false;
+	double took = chrono::duration<double>(_now - m_fetchStarted).count();
+	return took > max(c_minOverdue, m_latency * c_overdueFactor);
+}
+
+void DownloadSub::releaseFetch()
+{
+	Guard l(m_fetch);
+	// Leave m_remaining & m_indices so that stragglers are still accepted; the fetch no longer counts as taken.
+	m_asked.clear();
+	m_released = true;
+	// Count it as a fetch that delivered what it had so far, so that next time we ask for less.
+	noteFetched();
+}
@@ -24,6 +24,7 @@
 #include <map>
 #include <vector>
 #include <set>
+#include <chrono>
 #include <libdevcore/Guards.h>
 #include <libdevcore/Worker.h>
 #include <libdevcore/RangeMask.h>
@@ -45,7 +46,8 @@ public:
 	DownloadSub(DownloadMan& _man);
 	~DownloadSub();
 
-	/// Finished last fetch - grab the next bunch of block hashes to download.
+	/// Finished last fetch - grab the next bunch of block hashes to download. At most @a _n are given; fewer if this
+	/// peer hasn't yet shown it can deliver that many in good time.
 	h256Set nextFetch(unsigned _n);
 
 	/// Note that we've received a particular block. @returns true if we had asked for it but haven't received it yet.
@@ -54,6 +56,14 @@ public:
 	/// Nothing doing here.
 	void doneFetch() { resetFetch(); }
 
+	/// @returns true if the present fetch will, by @a _now, have been outstanding for much longer than this peer's
+	/// record says it should.
+	bool isOverdue(std::chrono::steady_clock::time_point _now = std::chrono::steady_clock::now()) const;
+
+	/// Give up on the present fetch so that other subs may take its blocks. Any that still arrive are accepted, but the
+	/// next fetch is fresh rather than a retry of this one.
+	void releaseFetch();
+
 	bool askedContains(unsigned _i) const { Guard l(m_fetch); return m_asked.contains(_i); }
 	RangeMask<unsigned> const& asked() const { return m_asked; }
 	RangeMask<unsigned> const& attemped() const { return m_attempted; }
@@ -66,8 +76,12 @@ private:
 		m_indices.clear();
 		m_asked.reset();
 		m_attempted.reset();
+		m_released = false;
 	}
 
+	/// Fold the fetch just finished into our rate & latency estimates. Expects m_fetch to be locked.
+	void noteFetched();
+
 	DownloadMan* m_man = nullptr;
 
 	mutable Mutex m_fetch;
@@ -75,6 +89,12 @@ private:
 	std::map<h256, unsigned> m_indices;
 	RangeMask<unsigned> m_asked;
 	RangeMask<unsigned> m_attempted;
+	bool m_released = false;				///< True if the present fetch has been given up to other subs.
+
+	std::chrono::steady_clock::time_point m_fetchStarted;	///< When the present fetch was asked for.
+	unsigned m_fetchReceived = 0;			///< How many of the present fetch's blocks have arrived.
+	double m_rate = 0;						///< Moving average of blocks delivered per second.
+	double m_latency = 0;					///< Moving average of seconds taken per fetch; 0 until measured.
 };
 
 class DownloadMan
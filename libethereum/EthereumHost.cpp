@@ -62,9 +62,6 @@ bool EthereumHost::ensureInitialised()
 		// First time - just initialise.
 		m_latestBlockSent = m_chain.currentHash();
 		clog(NetNote) << "Initialising: latest=" << m_latestBlockSent.abridged();
-
-		for (auto const& i: m_tq.transactions())
-			m_transactionsSent.insert(i.first);
 		return true;
 	}
 	return false;
@@ -92,6 +89,8 @@ void EthereumHost::changeSyncer(EthereumPeer* _syncer)
 		clog(NetAllDetail) << "Clearing syncer.";
 
 	m_syncer = _syncer;
+	if (_syncer)
+		m_syncerSession = _syncer->session()->shared_from_this();
 	if (isSyncing())
 	{
 		if (_syncer->m_asking == Asking::Blocks)
@@ -140,19 +139,20 @@ void EthereumHost::noteDoneBlocks(EthereumPeer* _who, bool _clemency)
 
 void EthereumHost::reset()
 {
+	RecursiveGuard l(x_sync);
 	if (m_syncer)
 		m_syncer->abortSync();
 
 	m_man.resetToChain(h256s());
 
 	m_latestBlockSent = h256();
-	m_transactionsSent.clear();
 }
 
 void EthereumHost::doWork()
 {
 	bool netChange = ensureInitialised();
 	auto h = m_chain.currentHash();
+	maintainSync();
 	// If we've finished our initial sync (including getting all the blocks into the chain so as to reduce invalid transactions), start trading transactions & blocks
 	if (!isSyncing() && m_chain.isKnown(m_latestBlockSent))
 	{
@@ -164,31 +164,126 @@ void EthereumHost::doWork()
 	(void)netChange;
 }
 
+void EthereumHost::maintainSync()
+{
+	// Both declared before the lock, so that any peer they were last to hold goes only once it's released.
+	auto ps = peers();
+	shared_ptr<Session> done;
+
+	// Take blocks away from any peer that's sitting on them for too long, and get idle peers to pick them up.
+	// This drives the peers' sync state from our thread rather than the network's, so it must hold x_sync.
+	RecursiveGuard l(x_sync);
+	if (m_syncer && !m_syncer->session()->isOpen())
+	{
+		// We hold its session, so it's still here to be aborted; it's not to be picked again.
+		clog(NetNote) << "Syncing peer disconnected; aborting sync.";
+		m_syncer->resetNeedsSyncing();
+		m_syncer->abortSync();
+	}
+	if (!m_syncer)
+		done.swap(m_syncerSession);
+	if (!isSyncing())
+		return;
+
+	bool released = false;
+	for (auto const& p: ps)
+		if (auto ep = p->cap<EthereumPeer>())
+			if (ep->m_asking == Asking::Blocks && ep->m_sub.isOverdue())
+			{
+				clog(NetNote) << "Blocks fetch from" << p->socketId() << "overdue; releasing to other peers.";
+				ep->m_sub.releaseFetch();
+				released = true;
+				// Any stragglers are still taken, but it's free to be given another (smaller) fetch.
+				if (ep->isSyncing())
+					ep->transition(Asking::Blocks);
+				else
+					ep->setAsking(Asking::Nothing, false);
+			}
+	if (released && m_syncer && m_syncer->m_asking == Asking::Blocks)
+		for (auto const& p: ps)
+			if (auto ep = p->cap<EthereumPeer>())
+				if (ep->m_asking == Asking::Nothing && p->isOpen())
+					ep->transition(Asking::Blocks);
+}
+
 void EthereumHost::maintainTransactions()
 {
-	// Send any new transactions.
-	for (auto const& p: peers())
+	// Work out who's to be sent anything and from how far back we need the queue's transactions to do it.
+	auto ps = peers();
+	vector<shared_ptr<EthereumPeer>> due;
+	unsigned since = m_tq.sequence();
+	for (auto const& p: ps)
 		if (auto ep = p->cap<EthereumPeer>())
 		{
-			bytes b;
-			unsigned n = 0;
-			for (auto const& i: m_tq.transactions())
-				if (ep->m_requireTransactions || (!m_transactionsSent.count(i.first) && !ep->m_knownTransactions.count(i.first)))
-				{
-					b += i.second;
-					++n;
-					m_transactionsSent.insert(i.first);
-				}
-			ep->clearKnownTransactions();
+			// Don't pile more onto a peer that can't keep up with what we're already sending it.
+			if (!ep->m_requireTransactions && ep->session()->isBackedUp())
+				continue;
+			// A peer that's just asked gets all of them.
+			if (ep->m_requireTransactions)
+				ep->m_transactionsCursor = 0;
+			since = min(since, ep->m_transactionsCursor);
+			due.push_back(ep);
+		}
+	if (due.empty())
+		return;
 
-			if (n || ep->m_requireTransactions)
+	unsigned now;
+	auto fresh = m_tq.transactionsSince(since, now);
+
+	// Send each peer those that became ready since its cursor. Peers with the same cursor and id offset get the same
+	// packet, so it's encoded once and shared; only a peer that already knows some of the batch gets its own.
+	map<pair<unsigned, unsigned>, shared_ptr<bytes const>> packets;
+	for (auto const& ep: due)
+	{
+		auto from = fresh.upper_bound(ep->m_transactionsCursor);
+		bool knowsSome = false;
+		{
+			Guard l(ep->x_knownTransactions);
+			for (auto i = from; i != fresh.end() && !knowsSome; ++i)
+				knowsSome = ep->m_knownTransactions.count(i->second.first);
+		}
+
+		shared_ptr<bytes const> packet;
+		if (from != fresh.end() || ep->m_requireTransactions)
+		{
+			auto& shared = packets[make_pair(ep->m_transactionsCursor, ep->idOffset())];
+			if (knowsSome || !shared)
 			{
-				RLPStream ts;
-				ep->prep(ts, TransactionsPacket, n).appendRaw(b, n);
-				ep->sealAndSend(ts);
+				bytes b;
+				unsigned n = 0;
+				{
+					Guard l(ep->x_knownTransactions);
+					for (auto i = from; i != fresh.end(); ++i)
+						if (!knowsSome || !ep->m_knownTransactions.count(i->second.first))
+						{
+							b += i->second.second;
+							++n;
+						}
+				}
+				if (n || ep->m_requireTransactions)
+				{
+					RLPStream ts;
+					ep->prep(ts, TransactionsPacket, n).appendRaw(b, n);
+					packet = ep->seal(ts);
+				}
+				if (!knowsSome)
+					shared = packet;
 			}
-			ep->m_requireTransactions = false;
+			else
+				packet = shared;
 		}
+		{
+			// Forget only those dealt with here: the peer may have just sent us some that aren't yet ready.
+			Guard l(ep->x_knownTransactions);
+			for (auto i = from; i != fresh.end(); ++i)
+				ep->m_knownTransactions.erase(i->second.first);
+		}
+
+		if (packet)
+			ep->send(packet);
+		ep->m_transactionsCursor = now;
+		ep->m_requireTransactions = false;
+	}
 }
 
 void EthereumHost::maintainBlocks(h256 _currentHash)
@@ -198,16 +293,26 @@ void EthereumHost::maintainBlocks(h256 _currentHash)
 	{
 		clog(NetMessageSummary) << "Sending a new block (current is" << _currentHash << ", was" << m_latestBlockSent << ")";
 
+		// The packet differs between peers only in its id, so it's made once for each id offset and shared.
+		bytes block = m_chain.block();
+		u256 td = m_chain.details().totalDifficulty;
+		map<unsigned, shared_ptr<bytes const>> packets;
 		for (auto j: peers())
 		{
 			auto p = j->cap<EthereumPeer>();
 
-			RLPStream ts;
-			p->prep(ts, NewBlockPacket, 2).appendRaw(m_chain.block(), 1).append(m_chain.details().totalDifficulty);
-
 			Guard l(p->x_knownBlocks);
 			if (!p->m_knownBlocks.count(_currentHash))
-				p->sealAndSend(ts);
+			{
+				auto& packet = packets[p->idOffset()];
+				if (!packet)
+				{
+					RLPStream ts;
+					p->prep(ts, NewBlockPacket, 2).appendRaw(block, 1).append(td);
+					packet = p->seal(ts);
+				}
+				p->send(packet);
+			}
 			p->m_knownBlocks.clear();
 		}
 		m_latestBlockSent = _currentHash;
@@ -85,6 +85,8 @@ private:
 	/// Sync with the BlockChain. It might contain one of our mined blocks, we might have new candidates from the network.
 	void doWork();
 
+	/// Hand the blocks of any overdue fetch on to other peers.
+	void maintainSync();
 	void maintainTransactions();
 	void maintainBlocks(h256 _currentBlock);
 
@@ -110,12 +112,17 @@ private:
 
 	u256 m_networkId;
 
+	/// Guards the sync state: m_syncer, m_man's chain, m_latestBlockSent and each peer's asking & syncing state.
+	/// Held by the network thread while a packet changes that state and by our worker while it maintains the sync.
+	/// Host's x_peers may be taken while holding it, never the other way round.
+	mutable RecursiveMutex x_sync;
 	EthereumPeer* m_syncer = nullptr;	// TODO: switch to weak_ptr
+	/// Keeps the syncer alive until we've aborted its sync, and the last one until maintainSync() lets it go.
+	std::shared_ptr<p2p::Session> m_syncerSession;
 
 	DownloadMan m_man;
 
 	h256 m_latestBlockSent;
-	h256Set m_transactionsSent;
 
 	std::set<p2p::NodeId> m_banned;
 };
@@ -41,14 +41,17 @@ using namespace p2p;
 
 EthereumPeer::EthereumPeer(Session* _s, HostCapabilityFace* _h, unsigned _i):
 	Capability(_s, _h, _i),
-	m_sub(host()->m_man)
+	m_sub(host()->m_man),
+	m_transactionsCursor(host()->m_tq.sequence())
 {
+	RecursiveGuard l(host()->x_sync);
 	transition(Asking::State);
 }
 
 EthereumPeer::~EthereumPeer()
 {
-	abortSync();
+	// The host holds its syncer's session until it has aborted the sync, so we can't be syncing by now and there's
+	// nothing to undo. Just as well: we may be destroyed by a thread holding Host's x_peers, so mustn't take x_sync.
 }
 
 void EthereumPeer::abortSync()
@@ -291,6 +294,7 @@ void EthereumPeer::attemptSync()
 
 bool EthereumPeer::interpret(unsigned _id, RLP const& _r)
 {
+	// Only changes to the sync state hold the host's x_sync; importing & serving needn't hold up the other peers.
 	try
 	{
 	switch (_id)
@@ -318,7 +322,10 @@ bool EthereumPeer::interpret(unsigned _id, RLP const& _r)
 		else if (host()->isBanned(session()->id()))
 			disable("Peer banned for previous bad behaviour.");
 		else
+		{
+			RecursiveGuard l(host()->x_sync);
 			transition(Asking::Nothing);
+		}
 		break;
 	}
 	case GetTransactionsPacket: break;	// DEPRECATED.
@@ -326,15 +333,20 @@ bool EthereumPeer::interpret(unsigned _id, RLP const& _r)
 	{
 		clogS(NetMessageSummary) << "Transactions (" << dec << (_r.itemCount() - 1) << "entries)";
 		addRating(_r.itemCount() - 1);
-		Guard l(x_knownTransactions);
+		vector<bytesConstRef> txs;
 		for (unsigned i = 1; i < _r.itemCount(); ++i)
+			txs.push_back(_r[i].data());
 		{
-			auto h = sha3(_r[i].data());
-			m_knownTransactions.insert(h);
-			if (!host()->m_tq.import(_r[i].data()))
-				// if we already had the transaction, then don't bother sending it on.
-				host()->m_transactionsSent.insert(h);
+			// Noted before they're imported, lest our worker see them become ready & send them straight back.
+			Guard l(x_knownTransactions);
+			// Forgetting is harmless (at worst we send them something they have), so don't let a peer we can't keep up with grow this without bound.
+			if (m_knownTransactions.size() + txs.size() > c_maxKnownTransactions)
+				m_knownTransactions.clear();
+			for (auto const& tx: txs)
+				m_knownTransactions.insert(sha3(tx));
 		}
+		// Those we already had don't become ready again, so they won't be sent on.
+		host()->m_tq.import(txs);
 		break;
 	}
 	case GetBlockHashesPacket:
@@ -343,13 +355,12 @@ bool EthereumPeer::interpret(unsigned _id, RLP const& _r)
 		unsigned limit = _r[2].toInt<unsigned>();
 		clogS(NetMessageSummary) << "GetBlockHashes (" << limit << "entries," << later.abridged() << ")";
 
-		unsigned c = min<unsigned>(host()->m_chain.number(later), limit);
+		h256s hashes = host()->m_chain.ancestors(later, min(limit, c_maxHashes));
 
 		RLPStream s;
-		prep(s, BlockHashesPacket, c);
-		h256 p = host()->m_chain.details(later).parent;
-		for (unsigned i = 0; i < c && p; ++i, p = host()->m_chain.details(p).parent)
-			s << p;
+		prep(s, BlockHashesPacket, hashes.size());
+		for (auto const& h: hashes)
+			s << h;
 		sealAndSend(s);
 		break;
 	}
@@ -357,6 +368,7 @@ bool EthereumPeer::interpret(unsigned _id, RLP const& _r)
 	{
 		clogS(NetMessageSummary) << "BlockHashes (" << dec << (_r.itemCount() - 1) << "entries)" << (_r.itemCount() - 1 ? "" : ": NoMoreHashes");
 
+		RecursiveGuard l(host()->x_sync);
 		if (m_asking != Asking::Hashes)
 		{
 			cwarn << "Peer giving us hashes when we didn't ask for them.";
@@ -385,20 +397,22 @@ bool EthereumPeer::interpret(unsigned _id, RLP const& _r)
 	case GetBlocksPacket:
 	{
 		clogS(NetMessageSummary) << "GetBlocks (" << dec << (_r.itemCount() - 1) << "entries)";
-		// return the requested blocks.
-		bytes rlp;
-		unsigned n = 0;
+		// return the requested blocks, straight from the chain's cache or DB into the packet.
+		h256s hashes;
 		for (unsigned i = 1; i < _r.itemCount() && i <= c_maxBlocks; ++i)
-		{
-			auto b = host()->m_chain.block(_r[i].toHash<h256>());
-			if (b.size())
-			{
-				rlp += b;
-				++n;
-			}
-		}
+			hashes.push_back(_r[i].toHash<h256>());
+
 		RLPStream s;
-		prep(s, BlocksPacket, n).appendRaw(rlp, n);
+		host()->m_chain.withBlocks(hashes, [&](vector<bytesConstRef> const& _blocks)
+		{
+			size_t size = 0;
+			for (auto const& b: _blocks)
+				size += b.size();
+			s.reserve(size + 32);
+			prep(s, BlocksPacket, _blocks.size());
+			for (auto const& b: _blocks)
+				s.appendRaw(b);
+		});
 		sealAndSend(s);
 		break;
 	}
@@ -406,12 +420,10 @@ bool EthereumPeer::interpret(unsigned _id, RLP const& _r)
 	{
 		clogS(NetMessageSummary) << "Blocks (" << dec << (_r.itemCount() - 1) << "entries)" << (_r.itemCount() - 1 ? "" : ": NoMoreBlocks");
 
-		if (m_asking != Asking::Blocks)
-			clogS(NetWarn) << "Unexpected Blocks received!";
-
 		if (_r.itemCount() == 1)
 		{
 			// Got to this peer's latest block - just give up.
+			RecursiveGuard l(host()->x_sync);
 			transition(Asking::Nothing);
 			break;
 		}
@@ -461,8 +473,11 @@ bool EthereumPeer::interpret(unsigned _id, RLP const& _r)
 
 		clogS(NetMessageSummary) << dec << success << "imported OK," << unknown << "with unknown parents," << future << "with future timestamps," << got << " already known," << repeated << " repeats received.";
 
+		RecursiveGuard l(host()->x_sync);
 		if (m_asking == Asking::Blocks)
 			transition(Asking::Blocks);
+		else
+			clogS(NetWarn) << "Unexpected Blocks received!";
 		break;
 	}
 	case NewBlockPacket:
@@ -492,10 +507,13 @@ bool EthereumPeer::interpret(unsigned _id, RLP const& _r)
 				break;
 
 			case ImportResult::UnknownParent:
+			{
 				clogS(NetMessageSummary) << "Received block with no known parent. Resyncing...";
+				RecursiveGuard l(host()->x_sync);
 				setNeedsSyncing(h, _r[2].toInt<u256>());
 				break;
 			}
+			}
 			Guard l(x_knownBlocks);
 			m_knownBlocks.insert(h);
 		}
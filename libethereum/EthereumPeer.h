@@ -82,9 +82,6 @@ private:
 	/// Abort the sync operation.
 	void abortSync();
 
-	/// Clear all known transactions.
-	void clearKnownTransactions() { std::lock_guard<std::mutex> l(x_knownTransactions); m_knownTransactions.clear(); }
-
 	/// Update our asking state.
 	void setAsking(Asking _g, bool _isSyncing);
 
@@ -127,12 +124,14 @@ private:
 	DownloadSub m_sub;
 
 	/// Have we received a GetTransactions packet that we haven't yet answered?
-	bool m_requireTransactions;
+	bool m_requireTransactions = false;
+	/// The point in the transaction queue's sequence up to which we've sent the peer transactions.
+	unsigned m_transactionsCursor = 0;
 
 	Mutex x_knownBlocks;
 	h256Set m_knownBlocks;					///< Blocks that the peer already knows about (that don't need to be sent to them).
 	Mutex x_knownTransactions;
-	h256Set m_knownTransactions;			///< Transactions that the peer already knows of.
+	h256Set m_knownTransactions;			///< Transactions that the peer already knows of. Bounded by c_maxKnownTransactions.
 
 };
 
@@ -39,6 +39,12 @@ Executive::Executive(State& _s, BlockChain const& _bc, unsigned _level):
 	m_depth(_level)
 {}
 
+Executive::~Executive()
+{
+	if (m_vm)
+		VMFactory::recycle(std::move(m_vm));
+}
+
 u256 Executive::gasUsed() const
 {
 	return m_t.gas() - m_endGas;
@@ -51,9 +57,14 @@ void Executive::accrueSubState(SubState& _parentContext)
 }
 
 bool Executive::setup(bytesConstRef _rlp)
+{
+	return setup(Transaction(_rlp));
+}
+
+bool Executive::setup(Transaction const& _t)
 {
 	// Entry point for a user-executed transaction.
-	m_t = Transaction(_rlp);
+	m_t = _t;
 
 	// Avoid invalid transactions.
 	auto nonceReq = m_s.transactionsFrom(m_t.sender());
@@ -128,6 +139,7 @@ bool Executive::call(Address _receiveAddress, Address _codeAddress, Address _sen
 		m_vm = VMFactory::create(_gas);
 		bytes const& c = m_s.code(_codeAddress);
 		m_ext = make_shared<ExtVM>(m_s, m_lastHashes, _receiveAddress, _senderAddress, _originAddress, _value, _gasPrice, _data, &c, m_depth);
+		m_ext->codeHash = m_s.codeHash(_codeAddress);
 	}
 	else
 		m_endGas = _gas;
@@ -143,12 +155,13 @@ bool Executive::create(Address _sender, u256 _endowment, u256 _gasPrice, u256 _g
 	m_newAddress = right160(sha3(rlpList(_sender, m_s.transactionsFrom(_sender) - 1)));
 
 	// Set up new account...
-	m_s.m_cache[m_newAddress] = Account(m_s.balance(m_newAddress) + _endowment, Account::ContractConception);
+	u256 balance = m_s.balance(m_newAddress) + _endowment;
+	m_s.changeAccount(m_newAddress) = Account(balance, Account::ContractConception);
 
 	// Execute _init.
 	if (_init.empty())
 	{
-		m_s.m_cache[m_newAddress].setCode({});
+		m_s.changeAccount(m_newAddress).setCode({});
 		m_endGas = _gas;
 	}
 	else
@@ -197,7 +210,7 @@ bool Executive::go(OnOpFunc const& _onOp)
 					m_endGas -= m_out.size() * c_createDataGas;
 				else
 					m_out.reset();
-				m_s.m_cache[m_newAddress].setCode(m_out.toBytes());
+				m_s.changeAccount(m_newAddress).setCode(m_out.toBytes());
 			}
 		}
 		catch (StepsDone const&)
@@ -244,7 +257,7 @@ void Executive::finalize()
 	// Suicides...
 	if (m_ext)
 		for (auto a: m_ext->sub.suicides)
-			m_s.m_cache[a].kill();
+			m_s.changeAccount(a).kill();
 
 	// Logs..
 	if (m_ext)
@@ -53,8 +53,8 @@ public:
 	Executive(State& _s, LastHashes const& _lh, unsigned _level): m_s(_s), m_lastHashes(_lh), m_depth(_level) {}
 	/// Basic constructor.
 	Executive(State& _s, BlockChain const& _bc, unsigned _level);
-	/// Basic destructor.
-	~Executive() = default;
+	/// Basic destructor. Hands the VM, if any, back for reuse.
+	~Executive();
 
 	Executive(Executive const&) = delete;
 	void operator=(Executive) = delete;
@@ -62,6 +62,8 @@ public:
 	/// Set up the executive for evaluating a transaction. You must call finalize() following this.
 	/// @returns true iff go() must be called (and thus a VM execution in required).
 	bool setup(bytesConstRef _transaction);
+	/// As above, but for an already-decoded transaction, whose sender may already have been recovered.
+	bool setup(Transaction const& _transaction);
 	/// Finalise a transaction previously set up with setup().
 	/// @warning Only valid after setup(), and possibly go().
 	void finalize();
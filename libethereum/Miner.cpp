@@ -78,8 +78,8 @@ void Miner::doWork()
 			if (mineInfo.completed)
 			{
 				m_mineState.completeMine();
-				m_host->onComplete();
 				m_miningStatus = Mined;
+				m_host->onComplete();
 			}
 			else
 				m_host->onProgressed();
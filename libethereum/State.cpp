@@ -27,6 +27,7 @@
 #include <boost/timer.hpp>
 #include <secp256k1/secp256k1.h>
 #include <libdevcore/CommonIO.h>
+#include <libdevcrypto/TrieHash.h>
 #include <libevmcore/Instruction.h>
 #include <libethcore/Exceptions.h>
 #include <libevm/VMFactory.h>
@@ -43,6 +44,8 @@ using namespace dev::eth;
 
 static const u256 c_blockReward = 1500 * finney;
 
+bool State::s_speculative = false;
+
 OverlayDB State::openDB(std::string _path, bool _killExisting)
 {
 	if (_path.empty())
@@ -60,12 +63,14 @@ OverlayDB State::openDB(std::string _path, bool _killExisting)
 		BOOST_THROW_EXCEPTION(DatabaseAlreadyOpen());
 
 	cnote << "Opened state DB.";
+	StateSnapshot::attach(db);
 	return OverlayDB(db);
 }
 
 State::State(Address _coinbaseAddress, OverlayDB const& _db, BaseState _bs):
 	m_db(_db),
 	m_state(&m_db),
+	m_snapshot(StateSnapshot::of(m_db.db())),
 	m_ourAddress(_coinbaseAddress),
 	m_blockReward(c_blockReward)
 {
@@ -78,6 +83,8 @@ State::State(Address _coinbaseAddress, OverlayDB const& _db, BaseState _bs):
 	{
 		dev::eth::commit(genesisState(), m_db, m_state);
 		m_db.commit();
+		if (m_snapshot && !m_snapshot->root())
+			m_snapshot->rebuild(m_state, m_db);
 
 		paranoia("after DB commit of normal construction.", true);
 		m_previousBlock = BlockChain::genesis();
@@ -97,6 +104,7 @@ State::State(Address _coinbaseAddress, OverlayDB const& _db, BaseState _bs):
 State::State(OverlayDB const& _db, BlockChain const& _bc, h256 _h):
 	m_db(_db),
 	m_state(&m_db),
+	m_snapshot(StateSnapshot::of(m_db.db())),
 	m_blockReward(c_blockReward)
 {
 	// TODO THINK: is this necessary?
@@ -124,6 +132,11 @@ State::State(State const& _s):
 	m_receipts(_s.m_receipts),
 	m_transactionSet(_s.m_transactionSet),
 	m_cache(_s.m_cache),
+	m_changes(_s.m_changes),
+	m_snapshot(_s.m_snapshot),
+	m_flatRoot(_s.m_flatRoot),
+	m_flatWhole(_s.m_flatWhole),
+	m_flatAltered(_s.m_flatAltered),
 	m_previousBlock(_s.m_previousBlock),
 	m_currentBlock(_s.m_currentBlock),
 	m_ourAddress(_s.m_ourAddress),
@@ -156,6 +169,11 @@ State& State::operator=(State const& _s)
 	m_receipts = _s.m_receipts;
 	m_transactionSet = _s.m_transactionSet;
 	m_cache = _s.m_cache;
+	m_changes = _s.m_changes;
+	m_snapshot = _s.m_snapshot;
+	m_flatRoot = _s.m_flatRoot;
+	m_flatWhole = _s.m_flatWhole;
+	m_flatAltered = _s.m_flatAltered;
 	m_previousBlock = _s.m_previousBlock;
 	m_currentBlock = _s.m_currentBlock;
 	m_ourAddress = _s.m_ourAddress;
@@ -220,16 +238,68 @@ StateDiff State::diff(State const& _c) const
 
 void State::ensureCached(Address _a, bool _requireCode, bool _forceCreate) const
 {
-	ensureCached(m_cache, _a, _requireCode, _forceCreate);
+	if (m_reads)
+		m_reads->existence.insert(_a);
+	ensureCached(m_cache, _a, _requireCode, false);
+	if (_forceCreate && !m_cache.count(_a))
+	{
+		m_changes.push_back(Change{Change::Create, _a, 0, 0, Account()});
+		ensureCached(m_cache, _a, _requireCode, true);
+	}
+}
+
+Account& State::changeAccount(Address _a)
+{
+	if (m_reads)
+	{
+		m_reads->balance.insert(_a);
+		m_reads->nonce.insert(_a);
+	}
+	ensureCached(_a, false, false);
+	auto it = m_cache.find(_a);
+	if (it == m_cache.end())
+	{
+		m_changes.push_back(Change{Change::Create, _a, 0, 0, Account()});
+		return m_cache[_a];
+	}
+	m_changes.push_back(Change{Change::Whole, _a, 0, 0, it->second});
+	return it->second;
+}
+
+void State::rollback(size_t _savepoint)
+{
+	while (m_changes.size() > _savepoint)
+	{
+		Change& c = m_changes.back();
+		switch (c.kind)
+		{
+		case Change::Create:
+			m_cache.erase(c.address);
+			break;
+		case Change::Balance:
+			m_cache[c.address].balance() = c.value;
+			break;
+		case Change::Nonce:
+			m_cache[c.address].nonce() = c.value;
+			break;
+		case Change::Storage:
+			m_cache[c.address].setStorage(c.key, c.value);
+			break;
+		case Change::Whole:
+			m_cache[c.address] = move(c.account);
+			break;
+		}
+		m_changes.pop_back();
+	}
 }
 
-void State::ensureCached(std::map<Address, Account>& _cache, Address _a, bool _requireCode, bool _forceCreate) const
+void State::ensureCached(AccountMap& _cache, Address _a, bool _requireCode, bool _forceCreate) const
 {
 	auto it = _cache.find(_a);
 	if (it == _cache.end())
 	{
 		// populate basic info.
-		string stateBack = m_state.at(_a);
+		string stateBack = accountRLP(_a);
 		if (stateBack.empty() && !_forceCreate)
 			return;
 		RLP state(stateBack);
@@ -242,13 +312,76 @@ void State::ensureCached(std::map<Address, Account>& _cache, Address _a, bool _r
 		tie(it, ok) = _cache.insert(make_pair(_a, s));
 	}
 	if (_requireCode && it != _cache.end() && !it->second.isFreshCode() && !it->second.codeCacheValid())
-		it->second.noteCode(it->second.codeHash() == EmptySHA3 ? bytesConstRef() : bytesConstRef(m_db.lookup(it->second.codeHash())));
+	{
+		h256 ch = it->second.codeHash();
+		CodeCache::Code code = CodeCache::get().lookup(ch);
+		if (!code)
+		{
+			code = make_shared<bytes const>(asBytes(m_db.lookup(ch)));
+			if (!code->empty())
+				CodeCache::get().insert(ch, code);
+		}
+		it->second.noteCode(code);
+	}
+}
+
+string State::accountRLP(Address const& _a) const
+{
+	string ret;
+	if (!isFlat(_a) || !m_snapshot->account(m_flatRoot, _a, ret))
+		ret = m_state.at(_a);
+	return ret;
+}
+
+bool State::syncSnapshot()
+{
+	if (!isSnapshotStale())
+		return false;
+	m_snapshot->rebuild(TrieDB<Address, OverlayDB>(&m_db, m_flatRoot), m_db);
+	return true;
 }
 
 void State::commit()
 {
-	dev::eth::commit(m_cache, m_db, m_state);
-	m_cache.clear();
+	if (m_writes)
+		noteWrites(*m_writes);
+
+	// Gather what the journal says has been altered: accounts that have been created or changed wholesale are
+	// written out entirely, others only in their header fields and whichever storage locations were set.
+	set<Address> whole;
+	map<Address, set<u256>> altered;
+	for (auto const& c: m_changes)
+		if (c.kind == Change::Create || c.kind == Change::Whole)
+			whole.insert(c.address);
+		else if (c.kind == Change::Storage)
+			altered[c.address].insert(c.key);
+		else
+			altered[c.address];
+
+	vector<AccountCommit> accounts;
+	for (auto const& a: whole)
+	{
+		auto it = m_cache.find(a);
+		if (it != m_cache.end())
+			accounts.push_back(AccountCommit{a, &it->second, nullptr});
+	}
+	for (auto const& i: altered)
+		if (!whole.count(i.first))
+		{
+			auto it = m_cache.find(i.first);
+			if (it != m_cache.end())
+				accounts.push_back(AccountCommit{i.first, &it->second, &i.second});
+		}
+	commitAccounts(accounts, m_db, m_state);
+
+	if (m_snapshot)
+	{
+		m_flatWhole.insert(whole.begin(), whole.end());
+		for (auto const& i: altered)
+			m_flatAltered[i.first].insert(i.second.begin(), i.second.end());
+	}
+
+	clearCache();
 }
 
 bool State::sync(BlockChain const& _bc)
@@ -351,6 +484,17 @@ u256 State::enactOn(bytesConstRef _block, BlockInfo const& _bi, BlockChain const
 	return enact(_block, _bc);
 }
 
+u256 State::enactOn(VerifiedBlock const& _block, BlockChain const& _bc)
+{
+	// Check family:
+	BlockInfo biParent(_bc.block(_block.info.parentHash));
+	_block.info.verifyParent(biParent);
+	sync(_bc, _block.info.parentHash);
+	resetCurrent();
+	m_previousBlock = biParent;
+	return enact(_block.info, &_block.block, _block.transactions, _bc);
+}
+
 map<Address, u256> State::addresses() const
 {
 	map<Address, u256> ret;
@@ -368,7 +512,7 @@ void State::resetCurrent()
 	m_transactions.clear();
 	m_receipts.clear();
 	m_transactionSet.clear();
-	m_cache.clear();
+	clearCache();
 	m_currentBlock = BlockInfo();
 	m_currentBlock.coinbaseAddress = m_ourAddress;
 	m_currentBlock.timestamp = time(0);
@@ -381,6 +525,7 @@ void State::resetCurrent()
 
 	m_lastTx = m_db;
 	m_state.setRoot(m_previousBlock.stateRoot);
+	resetFlat();
 
 	paranoia("begin resetCurrent", true);
 }
@@ -423,6 +568,18 @@ TransactionReceipts State::sync(BlockChain const& _bc, TransactionQueue& _tq, bo
 	for (int goodTxs = 1; goodTxs;)
 	{
 		goodTxs = 0;
+
+		// If speculative, execute all those we don't have yet up front, concurrently. Going through them in order, each
+		// may then be placed by making its alterations again, unless something it read has since been altered.
+		map<h256, Speculation> speculations;
+		Writes written;
+		if (s_speculative)
+		{
+			uncommitToMine();
+			speculate(lh, ts, speculations);
+			m_writes = &written;
+		}
+
 		for (auto const& i: ts)
 			if (!m_transactionSet.count(i.first))
 			{
@@ -431,7 +588,11 @@ TransactionReceipts State::sync(BlockChain const& _bc, TransactionQueue& _tq, bo
 				{
 					uncommitToMine();
 //					boost::timer t;
-					execute(lh, i.second);
+					auto s = speculations.find(i.first);
+					if (s != speculations.end() && s->second.ok && !conflicts(s->second.reads, written) && gasUsed() + s->second.transaction.gas() <= m_currentBlock.gasLimit)
+						apply(s->second);
+					else
+						execute(lh, i.second);
 					ret.push_back(m_receipts.back());
 					_tq.noteGood(i);
 					++goodTxs;
@@ -465,18 +626,176 @@ TransactionReceipts State::sync(BlockChain const& _bc, TransactionQueue& _tq, bo
 						*o_transactionQueueChanged = true;
 				}
 			}
+		m_writes = nullptr;
 	}
 	return ret;
 }
 
+bool State::conflicts(Reads const& _r, Writes const& _w)
+{
+	// Any alteration to an account other than wholesale leaves its existence, code and storage root as good as ever.
+	for (auto const& a: _r.existence)
+		if (_w.whole.count(a))
+			return true;
+	for (auto const& a: _r.balance)
+		if (_w.balance.count(a))
+			return true;
+	for (auto const& a: _r.nonce)
+		if (_w.nonce.count(a))
+			return true;
+	for (auto const& i: _r.storage)
+		if (_w.storage.count(i))
+			return true;
+	for (auto const& a: _r.allStorage)
+	{
+		auto it = _w.storage.lower_bound(make_pair(a, u256()));
+		if (it != _w.storage.end() && it->first == a)
+			return true;
+	}
+	return false;
+}
+
+void State::noteWrites(Writes& o_writes) const
+{
+	for (auto const& c: m_changes)
+		switch (c.kind)
+		{
+		case Change::Create:
+		case Change::Whole:
+			o_writes.whole.insert(c.address);
+			break;
+		case Change::Balance:
+			o_writes.balance.insert(c.address);
+			break;
+		case Change::Nonce:
+			o_writes.nonce.insert(c.address);
+			break;
+		case Change::Storage:
+			o_writes.storage.insert(make_pair(c.address, c.key));
+			break;
+		}
+}
+
+void State::speculate(LastHashes const& _lh, map<h256, bytes> const& _ts, map<h256, Speculation>& o_speculations) const
+{
+	vector<pair<h256, bytes const*>> todo;
+	for (auto const& i: _ts)
+		if (!m_transactionSet.count(i.first))
+			todo.push_back(make_pair(i.first, &i.second));
+
+	// Each worker takes a contiguous share, executing one after another against its own copy of the state.
+	vector<Speculation> done(todo.size());
+	size_t workers = min<size_t>(todo.size(), ThreadPool::get().size() + 1);
+	ThreadPool::get().forEach(workers, [&](size_t w)
+	{
+		State s(*this);
+		for (size_t i = w * todo.size() / workers; i < (w + 1) * todo.size() / workers; ++i)
+			s.speculate(_lh, *todo[i].second, done[i]);
+	});
+
+	for (size_t i = 0; i < todo.size(); ++i)
+		o_speculations[todo[i].first] = move(done[i]);
+}
+
+void State::speculate(LastHashes const& _lh, bytes const& _rlp, Speculation& o_speculation)
+{
+	m_reads = &o_speculation.reads;
+	try
+	{
+		o_speculation.transaction = Transaction(&_rlp);
+		Executive e(*this, _lh, 0);
+		e.setup(o_speculation.transaction);
+#if ETH_VMTRACE
+		e.go(e.simpleTrace());
+#else
+		e.go();
+#endif
+		e.finalize();
+		o_speculation.gasUsed = e.gasUsed();
+		o_speculation.logs = e.logs();
+
+		noteWrites(o_speculation.writes);
+		for (auto const& c: m_changes)
+		{
+			// The first entry for each holds the value prior to the transaction.
+			if (c.kind == Change::Balance)
+				o_speculation.balanceBase.insert(make_pair(c.address, c.value));
+			else if (c.kind == Change::Nonce)
+				o_speculation.nonceBase.insert(make_pair(c.address, c.value));
+			if (!o_speculation.accounts.count(c.address))
+				o_speculation.accounts.insert(make_pair(c.address, m_cache.at(c.address)));
+		}
+		o_speculation.ok = true;
+	}
+	catch (Exception const& _e)
+	{
+		clog(StateDetail) << "Speculative execution failed; will execute afresh:" << diagnostic_information(_e);
+	}
+	catch (std::exception const& _e)
+	{
+		clog(StateDetail) << "Speculative execution failed; will execute afresh:" << _e.what();
+	}
+	m_reads = nullptr;
+	rollback(0);
+	clearCache();
+}
+
+void State::apply(Speculation const& _s)
+{
+	u256 startGasUsed = gasUsed();
+
+	// Balances and nonces are altered by the same amounts rather than set, since those the transaction only added to
+	// it never read and they may have been altered since. Anything it did read is as it was when it was executed.
+	for (auto const& a: _s.writes.whole)
+		changeAccount(a) = _s.accounts.at(a);
+	for (auto const& i: _s.balanceBase)
+		if (!_s.writes.whole.count(i.first))
+		{
+			u256 b = _s.accounts.at(i.first).balance();
+			if (b >= i.second)
+				addBalance(i.first, b - i.second);
+			else
+				subBalance(i.first, i.second - b);
+		}
+	for (auto const& i: _s.nonceBase)
+		if (!_s.writes.whole.count(i.first))
+		{
+			ensureCached(i.first, false, false);
+			auto it = m_cache.find(i.first);
+			if (it != m_cache.end())
+			{
+				m_changes.push_back(Change{Change::Nonce, i.first, 0, it->second.nonce(), Account()});
+				it->second.nonce() += _s.accounts.at(i.first).nonce() - i.second;
+			}
+		}
+	for (auto const& i: _s.writes.storage)
+		if (!_s.writes.whole.count(i.first))
+			setStorage(i.first, i.second, _s.accounts.at(i.first).storageOverlay().at(i.second));
+
+	commit();
+
+	m_transactions.push_back(_s.transaction);
+	m_receipts.push_back(TransactionReceipt(rootHash(), startGasUsed + _s.gasUsed, _s.logs));
+	m_transactionSet.insert(_s.transaction.sha3());
+}
+
 u256 State::enact(bytesConstRef _block, BlockChain const& _bc, bool _checkNonce)
+{
+	BlockInfo bi(_block, _checkNonce);
+	bi.verifyInternals(_block);
+	Transactions txs;
+	for (auto const& tr: RLP(_block)[1])
+		txs.push_back(Transaction(tr.data()));
+	return enact(bi, _block, txs, _bc);
+}
+
+u256 State::enact(BlockInfo const& _bi, bytesConstRef _block, Transactions const& _txs, BlockChain const& _bc)
 {
 	// m_currentBlock is assumed to be prepopulated and reset.
 
 #if !ETH_RELEASE
-	BlockInfo bi(_block, _checkNonce);
-	assert(m_previousBlock.hash == bi.parentHash);
-	assert(m_currentBlock.parentHash == bi.parentHash);
+	assert(m_previousBlock.hash == _bi.parentHash);
+	assert(m_currentBlock.parentHash == _bi.parentHash);
 	assert(rootHash() == m_previousBlock.stateRoot);
 #endif
 
@@ -484,55 +803,32 @@ u256 State::enact(bytesConstRef _block, BlockChain const& _bc, bool _checkNonce)
 		BOOST_THROW_EXCEPTION(InvalidParentHash());
 
 	// Populate m_currentBlock with the correct values.
-	m_currentBlock.populate(_block, _checkNonce);
-	m_currentBlock.verifyInternals(_block);
+	m_currentBlock = _bi;
 
 //	cnote << "playback begins:" << m_state.root();
 //	cnote << m_state;
 
-	MemoryDB tm;
-	GenericTrieDB<MemoryDB> transactionsTrie(&tm);
-	transactionsTrie.init();
-
-	MemoryDB rm;
-	GenericTrieDB<MemoryDB> receiptsTrie(&rm);
-	receiptsTrie.init();
-
 	LastHashes lh = getLastHashes(_bc, (unsigned)m_previousBlock.number);
 
 	// All ok with the block generally. Play back the transactions now...
-	unsigned i = 0;
-	for (auto const& tr: RLP(_block)[1])
-	{
-		RLPStream k;
-		k << i;
-
-		transactionsTrie.insert(&k.out(), tr.data());
-		execute(lh, tr.data());
-
-		RLPStream receiptrlp;
-		m_receipts.back().streamRLP(receiptrlp);
-		receiptsTrie.insert(&k.out(), &receiptrlp.out());
-		++i;
-	}
-
-	if (transactionsTrie.root() != m_currentBlock.transactionsRoot)
+	// The transactions root was checked along with the header.
+	vector<bytes> receipts;
+	for (auto const& tr: _txs)
 	{
-		cwarn << "Bad transactions state root!";
-		BOOST_THROW_EXCEPTION(InvalidTransactionsStateRoot());
+		execute(lh, tr);
+		receipts.push_back(m_receipts.back().rlp());
 	}
 
-	if (receiptsTrie.root() != m_currentBlock.receiptsRoot)
+	h256 receiptsRoot = orderedTrieRoot(receipts);
+	if (receiptsRoot != m_currentBlock.receiptsRoot)
 	{
 		cwarn << "Bad receipts state root.";
 		cwarn << "Block:" << toHex(_block);
 		cwarn << "Block RLP:" << RLP(_block);
-		cwarn << "Calculated: " << receiptsTrie.root();
-		for (unsigned j = 0; j < i; ++j)
+		cwarn << "Calculated: " << receiptsRoot;
+		for (unsigned j = 0; j < receipts.size(); ++j)
 		{
-			RLPStream k;
-			k << j;
-			auto b = asBytes(receiptsTrie.at(&k.out()));
+			auto const& b = receipts[j];
 			cwarn << j << ": ";
 			cwarn << "RLP: " << RLP(b);
 			cwarn << "Hex: " << toHex(b);
@@ -610,8 +906,10 @@ void State::cleanup(bool _fullCommit)
 	{
 		paranoia("immediately before database commit", true);
 
-		// Commit the new trie to disk.
+		// Commit the new trie to disk, and move the flat snapshot on to it.
 		m_db.commit();
+		if (m_snapshot)
+			m_snapshot->advance(m_flatRoot, m_state, m_db, m_flatWhole, m_flatAltered);
 
 		paranoia("immediately after database commit", true);
 		m_previousBlock = m_currentBlock;
@@ -626,7 +924,7 @@ void State::uncommitToMine()
 {
 	if (m_currentBlock.sha3Uncles)
 	{
-		m_cache.clear();
+		clearCache();
 		if (!m_transactions.size())
 			m_state.setRoot(m_previousBlock.stateRoot);
 		else
@@ -721,39 +1019,30 @@ void State::commitToMine(BlockChain const& _bc)
 		}
 	}
 
-	MemoryDB tm;
-	GenericTrieDB<MemoryDB> transactionsTrie(&tm);
-	transactionsTrie.init();
-
-	MemoryDB rm;
-	GenericTrieDB<MemoryDB> receiptsTrie(&rm);
-	receiptsTrie.init();
+	vector<bytes> transactions;
+	vector<bytes> receipts;
+	transactions.reserve(m_transactions.size());
+	receipts.reserve(m_receipts.size());
 
 	RLPStream txs;
 	txs.appendList(m_transactions.size());
 
 	for (unsigned i = 0; i < m_transactions.size(); ++i)
 	{
-		RLPStream k;
-		k << i;
-
-		RLPStream receiptrlp;
-		m_receipts[i].streamRLP(receiptrlp);
-		receiptsTrie.insert(&k.out(), &receiptrlp.out());
+		receipts.push_back(m_receipts[i].rlp());
 
 		RLPStream txrlp;
 		m_transactions[i].streamRLP(txrlp);
-		transactionsTrie.insert(&k.out(), &txrlp.out());
-
 		txs.appendRaw(txrlp.out());
+		transactions.push_back(txrlp.out());
 	}
 
 	txs.swapOut(m_currentTxs);
 
 	RLPStream(unclesCount).appendRaw(unclesData.out(), unclesCount).swapOut(m_currentUncles);
 
-	m_currentBlock.transactionsRoot = transactionsTrie.root();
-	m_currentBlock.receiptsRoot = receiptsTrie.root();
+	m_currentBlock.transactionsRoot = orderedTrieRoot(transactions);
+	m_currentBlock.receiptsRoot = orderedTrieRoot(receipts);
 	m_currentBlock.logBloom = logBloom();
 	m_currentBlock.sha3Uncles = sha3(m_currentUncles);
 
@@ -833,6 +1122,8 @@ bool State::addressHasCode(Address _id) const
 
 u256 State::balance(Address _id) const
 {
+	if (m_reads)
+		m_reads->balance.insert(_id);
 	ensureCached(_id, false, false);
 	auto it = m_cache.find(_id);
 	if (it == m_cache.end())
@@ -848,10 +1139,14 @@ void State::noteSending(Address _id)
 	{
 		cwarn << "Sending from non-existant account. How did it pay!?!";
 		// this is impossible. but we'll continue regardless...
+		m_changes.push_back(Change{Change::Create, _id, 0, 0, Account()});
 		m_cache[_id] = Account(1, 0);
 	}
 	else
+	{
+		m_changes.push_back(Change{Change::Nonce, _id, 0, it->second.nonce(), Account()});
 		it->second.incNonce();
+	}
 }
 
 void State::addBalance(Address _id, u256 _amount)
@@ -859,19 +1154,30 @@ void State::addBalance(Address _id, u256 _amount)
 	ensureCached(_id, false, false);
 	auto it = m_cache.find(_id);
 	if (it == m_cache.end())
+	{
+		m_changes.push_back(Change{Change::Create, _id, 0, 0, Account()});
 		m_cache[_id] = Account(_amount, Account::NormalCreation);
+	}
 	else
+	{
+		m_changes.push_back(Change{Change::Balance, _id, 0, it->second.balance(), Account()});
 		it->second.addBalance(_amount);
+	}
 }
 
 void State::subBalance(Address _id, bigint _amount)
 {
+	if (m_reads)
+		m_reads->balance.insert(_id);
 	ensureCached(_id, false, false);
 	auto it = m_cache.find(_id);
 	if (it == m_cache.end() || (bigint)it->second.balance() < _amount)
 		BOOST_THROW_EXCEPTION(NotEnoughCash());
 	else
+	{
+		m_changes.push_back(Change{Change::Balance, _id, 0, it->second.balance(), Account()});
 		it->second.addBalance(-_amount);
+	}
 }
 
 Address State::newContract(u256 _balance, bytes const& _code)
@@ -885,6 +1191,7 @@ Address State::newContract(u256 _balance, bytes const& _code)
 		auto it = m_cache.find(ret);
 		if (it == m_cache.end())
 		{
+			m_changes.push_back(Change{Change::Create, ret, 0, 0, Account()});
 			m_cache[ret] = Account(0, _balance, EmptyTrie, h);
 			return ret;
 		}
@@ -893,6 +1200,8 @@ Address State::newContract(u256 _balance, bytes const& _code)
 
 u256 State::transactionsFrom(Address _id) const
 {
+	if (m_reads)
+		m_reads->nonce.insert(_id);
 	ensureCached(_id, false, false);
 	auto it = m_cache.find(_id);
 	if (it == m_cache.end())
@@ -903,6 +1212,8 @@ u256 State::transactionsFrom(Address _id) const
 
 u256 State::storage(Address _id, u256 _memory) const
 {
+	if (m_reads)
+		m_reads->storage.insert(make_pair(_id, _memory));
 	ensureCached(_id, false, false);
 	auto it = m_cache.find(_id);
 
@@ -915,18 +1226,40 @@ u256 State::storage(Address _id, u256 _memory) const
 	if (mit != it->second.storageOverlay().end())
 		return mit->second;
 
-	// Not in the storage cache - go to the DB.
-	TrieDB<h256, OverlayDB> memdb(const_cast<OverlayDB*>(&m_db), it->second.baseRoot());			// promise we won't change the overlay! :)
-	string payload = memdb.at(_memory);
+	// Not in the storage cache - go to the flat snapshot or, should it not answer, the DB. A storage root other than
+	// the empty one can only have come from the trie, so it is the one the snapshot holds for an unaltered account.
+	string payload;
+	if (!isFlat(_id) || it->second.baseRoot() == EmptyTrie || !m_snapshot->storage(m_flatRoot, _id, _memory, payload))
+	{
+		TrieDB<h256, OverlayDB> memdb(const_cast<OverlayDB*>(&m_db), it->second.baseRoot());			// promise we won't change the overlay! :)
+		payload = memdb.at(_memory);
+	}
 	u256 ret = payload.size() ? RLP(payload).toInt<u256>() : 0;
 	it->second.setStorage(_memory, ret);
 	return ret;
 }
 
+void State::setStorage(Address _contract, u256 _location, u256 _value)
+{
+	// Make sure the base value is in the overlay so that the journal can restore it.
+	u256 old = storage(_contract, _location);
+	auto it = m_cache.find(_contract);
+	if (it == m_cache.end())
+	{
+		m_changes.push_back(Change{Change::Create, _contract, 0, 0, Account()});
+		it = m_cache.insert(make_pair(_contract, Account())).first;
+	}
+	else
+		m_changes.push_back(Change{Change::Storage, _contract, _location, old, Account()});
+	it->second.setStorage(_location, _value);
+}
+
 map<u256, u256> State::storage(Address _id) const
 {
 	map<u256, u256> ret;
 
+	if (m_reads)
+		m_reads->allStorage.insert(_id);
 	ensureCached(_id, false, false);
 	auto it = m_cache.find(_id);
 	if (it != m_cache.end())
@@ -972,7 +1305,8 @@ h256 State::codeHash(Address _contract) const
 {
 	if (!addressHasCode(_contract))
 		return EmptySHA3;
-	return m_cache[_contract].codeHash();
+	Account const& a = m_cache[_contract];
+	return a.isFreshCode() ? h256() : a.codeHash();
 }
 
 bool State::isTrieGood(bool _enforceRefs, bool _requireNoLeftOvers) const
@@ -1035,6 +1369,11 @@ u256 State::execute(BlockChain const& _bc, bytesConstRef _rlp, bytes* o_output,
 
 // TODO: maintain node overlay revisions for stateroots -> each commit gives a stateroot + OverlayDB; allow overlay copying for rewind operations.
 u256 State::execute(LastHashes const& _lh, bytesConstRef _rlp, bytes* o_output, bool _commit)
+{
+	return execute(_lh, Transaction(_rlp), o_output, _commit);
+}
+
+u256 State::execute(LastHashes const& _lh, Transaction const& _t, bytes* o_output, bool _commit)
 {
 #ifndef ETH_RELEASE
 	commit();	// get an updated hash
@@ -1042,13 +1381,13 @@ u256 State::execute(LastHashes const& _lh, bytesConstRef _rlp, bytes* o_output,
 
 	paranoia("start of execution.", true);
 
-	State old(*this);
 #if ETH_PARANOIA
+	State old(*this);
 	auto h = rootHash();
 #endif
 
 	Executive e(*this, _lh, 0);
-	e.setup(_rlp);
+	e.setup(_t);
 
 	u256 startGasUsed = gasUsed();
 
@@ -1073,7 +1412,7 @@ u256 State::execute(LastHashes const& _lh, bytesConstRef _rlp, bytes* o_output,
 
 	if (!_commit)
 	{
-		m_cache.clear();
+		clearCache();
 		return e.gasUsed();
 	}
 
@@ -1108,7 +1447,7 @@ u256 State::execute(LastHashes const& _lh, bytesConstRef _rlp, bytes* o_output,
 State State::fromPending(unsigned _i) const
 {
 	State ret = *this;
-	ret.m_cache.clear();
+	ret.clearCache();
 	_i = min<unsigned>(_i, m_transactions.size());
 	if (!_i)
 		ret.m_state.setRoot(m_previousBlock.stateRoot);
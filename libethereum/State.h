@@ -21,11 +21,14 @@
 
 #pragma once
 
+#include <algorithm>
 #include <array>
 #include <map>
+#include <set>
 #include <unordered_map>
 #include <libdevcore/Common.h>
 #include <libdevcore/RLP.h>
+#include <libdevcore/ThreadPool.h>
 #include <libdevcrypto/TrieDB.h>
 #include <libethcore/Exceptions.h>
 #include <libethcore/BlockInfo.h>
@@ -34,6 +37,8 @@
 #include <libevm/ExtVMFace.h>
 #include "TransactionQueue.h"
 #include "Account.h"
+#include "CodeCache.h"
+#include "StateSnapshot.h"
 #include "Transaction.h"
 #include "TransactionReceipt.h"
 #include "AccountDiff.h"
@@ -47,6 +52,7 @@ namespace eth
 {
 
 class BlockChain;
+struct VerifiedBlock;
 
 struct StateChat: public LogChannel { static const char* name() { return "-S-"; } static const int verbosity = 4; };
 struct StateTrace: public LogChannel { static const char* name() { return "=S="; } static const int verbosity = 7; };
@@ -91,6 +97,13 @@ public:
 	static OverlayDB openDB(bool _killExisting = false) { return openDB(std::string(), _killExisting); }
 	OverlayDB const& db() const { return m_db; }
 
+	/// Bring the DB's flat snapshot of the state, if it keeps one, to the base state of the current block by
+	/// rewriting it in full, should it reflect some other state. @returns true if it was rewritten.
+	bool syncSnapshot();
+
+	/// @returns true if syncSnapshot() would rewrite the snapshot.
+	bool isSnapshotStale() const { return m_snapshot && m_flatRoot == m_previousBlock.stateRoot && m_snapshot->root() != m_flatRoot; }
+
 	/// @returns the set containing all addresses currently in use in Ethereum.
 	std::map<Address, u256> addresses() const;
 
@@ -143,7 +156,11 @@ public:
 	/// @returns a list of receipts one for each transaction placed from the queue into the state.
 	/// @a o_transactionQueueChanged boolean pointer, the value of which will be set to true if the transaction queue
 	/// changed and the pointer is non-null
+	/// If speculative (see setSpeculative()), the transactions are first executed concurrently; the outcome is the same.
 	TransactionReceipts sync(BlockChain const& _bc, TransactionQueue& _tq, bool* o_transactionQueueChanged = nullptr);
+	/// Have sync() execute queued transactions speculatively and concurrently, each against the state as it stood
+	/// before any of them, placing those whose reads went unaltered by ones placed before and re-executing the rest.
+	static void setSpeculative(bool _speculative) { s_speculative = _speculative; }
 	/// Like sync but only operate on _tq, killing the invalid/old ones.
 	bool cull(TransactionQueue& _tq) const;
 
@@ -155,6 +172,7 @@ public:
 	u256 execute(BlockChain const& _bc, bytesConstRef _rlp, bytes* o_output = nullptr, bool _commit = true);
 	u256 execute(LastHashes const& _lh, bytes const& _rlp, bytes* o_output = nullptr, bool _commit = true) { return execute(_lh, &_rlp, o_output, _commit); }
 	u256 execute(LastHashes const& _lh, bytesConstRef _rlp, bytes* o_output = nullptr, bool _commit = true);
+	u256 execute(LastHashes const& _lh, Transaction const& _t, bytes* o_output = nullptr, bool _commit = true);
 
 	/// Get the remaining gas limit in this block.
 	u256 gasLimitRemaining() const { return m_currentBlock.gasLimit - gasUsed(); }
@@ -187,7 +205,7 @@ public:
 	u256 storage(Address _contract, u256 _memory) const;
 
 	/// Set the value of a storage position of an account.
-	void setStorage(Address _contract, u256 _location, u256 _value) { m_cache[_contract].setStorage(_location, _value); }
+	void setStorage(Address _contract, u256 _location, u256 _value);
 
 	/// Create a new contract.
 	Address newContract(u256 _balance, bytes const& _code);
@@ -203,6 +221,7 @@ public:
 
 	/// Get the code hash of an account.
 	/// @returns EmptySHA3 if no account exists at that address or if there is no code associated with the address.
+	/// @returns h256() if the account's code is still being initialised.
 	h256 codeHash(Address _contract) const;
 
 	/// Note that the given address is sending a transaction and thus increment the associated ticker.
@@ -252,18 +271,106 @@ public:
 	/// @returns the additional total difficulty.
 	u256 enactOn(bytesConstRef _block, BlockInfo const& _bi, BlockChain const& _bc);
 
+	/// Execute all transactions within a given block, already checked with BlockChain::verifyBlock().
+	/// @returns the additional total difficulty.
+	u256 enactOn(VerifiedBlock const& _block, BlockChain const& _bc);
+
 	/// Returns back to a pristine state after having done a playback.
 	/// @arg _fullCommit if true flush everything out to disk. If false, this effectively only validates
 	/// the block since all state changes are ultimately reversed.
 	void cleanup(bool _fullCommit);
 
 	/// Commit all changes waiting in the address cache to the DB.
+	/// Only the accounts and storage locations noted as altered in the journal are written; the rest of the
+	/// cache was merely read from the trie and is discarded.
 	void commit();
 
 	/// Sets m_currentBlock to a clean state, (i.e. no change from m_previousBlock).
 	void resetCurrent();
 
+	/// @returns a marker for the present point in the journal of changes to the address cache; pass to rollback().
+	size_t savepoint() const { return m_changes.size(); }
+
+	/// Undo all changes made to the address cache since @a _savepoint was taken.
+	void rollback(size_t _savepoint);
+
 private:
+	/// A single undoable alteration to the address cache.
+	struct Change
+	{
+		enum Kind
+		{
+			Create,		///< Account was introduced into the cache; undone by removing it.
+			Balance,	///< Balance was altered; value holds the prior balance.
+			Nonce,		///< Nonce was altered; value holds the prior nonce.
+			Storage,	///< Storage location key was altered; value holds its prior value.
+			Whole		///< Account was altered wholesale; account holds the prior account.
+		};
+
+		Kind kind;
+		Address address;
+		u256 key;
+		u256 value;
+		Account account;
+	};
+
+	/// What a transaction read of the state while executing speculatively. Every account read is in existence.
+	struct Reads
+	{
+		std::set<Address> existence;				///< Accounts whose existence, code or storage root was relied upon.
+		std::set<Address> balance;					///< Accounts whose balance was read.
+		std::set<Address> nonce;					///< Accounts whose nonce was read.
+		std::set<std::pair<Address, u256>> storage;	///< Storage locations read.
+		std::set<Address> allStorage;				///< Accounts whose storage was read in full.
+	};
+
+	/// What was altered in the state, as gathered from the journal of changes by noteWrites().
+	struct Writes
+	{
+		std::set<Address> whole;					///< Accounts created or altered wholesale.
+		std::set<Address> balance;					///< Accounts whose balance was altered.
+		std::set<Address> nonce;					///< Accounts whose nonce was altered.
+		std::set<std::pair<Address, u256>> storage;	///< Storage locations altered.
+	};
+
+	/// A transaction executed speculatively, together with what it read and the alterations it made.
+	struct Speculation
+	{
+		bool ok = false;							///< False if it threw; it is then executed afresh when its turn comes.
+		Transaction transaction;
+		u256 gasUsed;
+		LogEntries logs;
+		Reads reads;
+		Writes writes;
+		std::map<Address, u256> balanceBase;		///< Prior balance of each account whose balance was altered.
+		std::map<Address, u256> nonceBase;			///< Prior nonce of each account whose nonce was altered.
+		AccountMap accounts;						///< The resultant state of each account altered.
+	};
+
+	/// @returns true if anything noted in @a _r may have been altered by @a _w.
+	static bool conflicts(Reads const& _r, Writes const& _w);
+
+	/// Note into @a o_writes everything altered according to the journal of changes.
+	void noteWrites(Writes& o_writes) const;
+
+	/// Execute each of the transactions in @a _ts not yet placed concurrently, each against a copy of this state,
+	/// leaving the outcomes in @a o_speculations.
+	void speculate(LastHashes const& _lh, std::map<h256, bytes> const& _ts, std::map<h256, Speculation>& o_speculations) const;
+
+	/// Execute the transaction @a _rlp, noting its outcome in @a o_speculation, then undo it.
+	void speculate(LastHashes const& _lh, bytes const& _rlp, Speculation& o_speculation);
+
+	/// Place the transaction of @a _s as execute() would have, by making the same alterations.
+	/// Only valid if it does not conflict with anything placed since the state against which it was executed.
+	void apply(Speculation const& _s);
+
+	/// @returns the cached account at @a _a, noting its present state in the journal ready for wholesale alteration.
+	/// A dead account is created in the cache if none exists.
+	Account& changeAccount(Address _a);
+
+	/// Clear the address cache and with it the journal of changes.
+	void clearCache() const { m_cache.clear(); m_changes.clear(); }
+
 	/// Undo the changes to the state for committing to mine.
 	void uncommitToMine();
 
@@ -274,12 +381,25 @@ private:
 	void ensureCached(Address _a, bool _requireCode, bool _forceCreate) const;
 
 	/// Retrieve all information about a given address into a cache.
-	void ensureCached(std::map<Address, Account>& _cache, Address _a, bool _requireCode, bool _forceCreate) const;
+	void ensureCached(AccountMap& _cache, Address _a, bool _requireCode, bool _forceCreate) const;
+
+	/// @returns the trie entry for the account at @a _a, from the flat snapshot if it can answer for it.
+	std::string accountRLP(Address const& _a) const;
+
+	/// @returns true if the flat snapshot can answer for the account at @a _a, it being unaltered since m_flatRoot.
+	bool isFlat(Address const& _a) const { return m_snapshot && !m_flatWhole.count(_a) && !m_flatAltered.count(_a); }
+
+	/// Take the current root as that against which the flat snapshot is consulted.
+	void resetFlat() { m_flatRoot = m_state.root(); m_flatWhole.clear(); m_flatAltered.clear(); }
 
 	/// Execute the given block, assuming it corresponds to m_currentBlock.
 	/// Throws on failure.
 	u256 enact(bytesConstRef _block, BlockChain const& _bc, bool _checkNonce = true);
 
+	/// Execute the given block, whose header @a _bi has already been verified against it and whose transactions
+	/// are already decoded into @a _txs. Throws on failure.
+	u256 enact(BlockInfo const& _bi, bytesConstRef _block, Transactions const& _txs, BlockChain const& _bc);
+
 	/// Finalise the block, applying the earned rewards.
 	void applyRewards(Addresses const& _uncleAddresses);
 
@@ -298,7 +418,16 @@ private:
 	std::set<h256> m_transactionSet;			///< The set of transaction hashes that we've included in the state.
 	OverlayDB m_lastTx;
 
-	mutable std::map<Address, Account> m_cache;	///< Our address cache. This stores the states of each address that has (or at least might have) been changed.
+	mutable AccountMap m_cache;					///< Our address cache. This stores the states of each address that has (or at least might have) been changed.
+	mutable std::vector<Change> m_changes;		///< Journal of changes to m_cache since it was last cleared, in order of application.
+
+	std::shared_ptr<StateSnapshot> m_snapshot;	///< The flat snapshot of the state kept in m_db, if any.
+	h256 m_flatRoot;							///< The root against which m_snapshot is consulted for accounts unaltered since.
+	std::set<Address> m_flatWhole;				///< Accounts committed to the trie wholesale since m_flatRoot.
+	std::map<Address, std::set<u256>> m_flatAltered;	///< Other accounts committed to the trie since m_flatRoot, with the storage locations set.
+
+	Reads* m_reads = nullptr;					///< Where to note what is read of the state while speculating, if anywhere.
+	Writes* m_writes = nullptr;					///< Where to note what commit() writes, if anywhere.
 
 	BlockInfo m_previousBlock;					///< The previous block's information.
 	BlockInfo m_currentBlock;					///< The current block's information.
@@ -314,51 +443,170 @@ private:
 	u256 m_blockReward;
 
 	static std::string c_defaultPath;
+	static bool s_speculative;
 
 	friend std::ostream& operator<<(std::ostream& _out, State const& _s);
 };
 
 std::ostream& operator<<(std::ostream& _out, State const& _s);
 
+/**
+ * @brief Stages the writes made to a trie apart from the DB it reads through.
+ * Storage tries of different accounts are independent, so each may be worked on in a StagedDB of its own concurrently,
+ * provided the underlying DB is left alone meanwhile; replay() then applies the writes to it in the order made, so it
+ * ends up as if they had been made there directly.
+ */
 template <class DB>
-void commit(std::map<Address, Account> const& _cache, DB& _db, TrieDB<Address, DB>& _state)
+class StagedDB
 {
-	for (auto const& i: _cache)
-		if (!i.second.isAlive())
-			_state.remove(i.first);
+public:
+	explicit StagedDB(DB const* _db): m_db(_db) {}
+
+	std::string lookup(h256 _h) const { auto it = m_over.find(_h); return it != m_over.end() ? it->second : m_db->lookup(_h); }
+	bool exists(h256 _h) const { return m_over.count(_h) || m_db->exists(_h); }
+	void insert(h256 _h, bytesConstRef _v) { m_over[_h] = _v.toString(); m_log.push_back(std::make_pair(_h, true)); }
+	void kill(h256 _h) { m_log.push_back(std::make_pair(_h, false)); }
+	bool isEnforcingRefs() const { return m_db->isEnforcingRefs(); }
+
+	/// Make each insertion and removal staged here in @a _db, in order.
+	void replay(DB& _db) const
+	{
+		for (auto const& i: m_log)
+			if (i.second)
+				_db.insert(i.first, bytesConstRef(m_over.at(i.first)));
+			else
+				_db.kill(i.first);
+	}
+
+private:
+	DB const* m_db;
+	std::map<h256, std::string> m_over;
+	std::vector<std::pair<h256, bool>> m_log;	///< Each node inserted (true) or removed (false), in order.
+};
+
+/// @returns true if committing @a _account with @a _keys (see commitAccounts()) writes to its storage trie.
+inline bool touchesStorage(Account const& _account, std::set<u256> const* _keys)
+{
+	return _account.isAlive() && !_account.storageOverlay().empty() && (!_keys || !_keys->empty());
+}
+
+/// Write the locations of @a _account's storage overlay given by @a _keys, or the whole overlay in key order if none
+/// are given, to its storage trie in @a _db. Only call if touchesStorage().
+/// @returns the new root of the storage trie.
+template <class DB>
+h256 commitStorage(Account const& _account, DB& _db, std::set<u256> const* _keys)
+{
+	auto const& overlay = _account.storageOverlay();
+	TrieDB<h256, DB> storageDB(&_db, _account.baseRoot());
+	auto write = [&](u256 const& _key, u256 const& _value)
+	{
+		if (_value)
+			storageDB.insert(_key, rlp(_value));
 		else
+			storageDB.remove(_key);
+	};
+	if (_keys)
+	{
+		for (auto const& k: *_keys)
 		{
-			RLPStream s(4);
-			s << i.second.nonce() << i.second.balance();
-
-			if (i.second.storageOverlay().empty())
-			{
-				assert(i.second.baseRoot());
-				s.append(i.second.baseRoot());
-			}
-			else
-			{
-				TrieDB<h256, DB> storageDB(&_db, i.second.baseRoot());
-				for (auto const& j: i.second.storageOverlay())
-					if (j.second)
-						storageDB.insert(j.first, rlp(j.second));
-					else
-						storageDB.remove(j.first);
-				assert(storageDB.root());
-				s.append(storageDB.root());
-			}
-
-			if (i.second.isFreshCode())
-			{
-				h256 ch = sha3(i.second.code());
-				_db.insert(ch, &i.second.code());
-				s << ch;
-			}
-			else
-				s << i.second.codeHash();
+			auto it = overlay.find(k);
+			if (it != overlay.end())
+				write(it->first, it->second);
+		}
+	}
+	else
+	{
+		std::vector<u256> keys;
+		keys.reserve(overlay.size());
+		for (auto const& j: overlay)
+			keys.push_back(j.first);
+		std::sort(keys.begin(), keys.end());
+		for (auto const& k: keys)
+			write(k, overlay.at(k));
+	}
+	assert(storageDB.root());
+	return storageDB.root();
+}
+
+/// Write the entry of @a _account, whose storage trie has root @a _storageRoot, into the state trie @a _state, or
+/// remove it if it is dead. Fresh code is written to @a _db.
+template <class DB>
+void commitEntry(Address const& _address, Account const& _account, h256 const& _storageRoot, DB& _db, TrieDB<Address, DB>& _state)
+{
+	if (!_account.isAlive())
+	{
+		_state.remove(_address);
+		return;
+	}
+
+	RLPStream s(4);
+	s << _account.nonce() << _account.balance();
+	s.append(_storageRoot);
+
+	if (_account.isFreshCode())
+	{
+		h256 ch = sha3(_account.code());
+		_db.insert(ch, &_account.code());
+		if (_account.sharedCode())
+			CodeCache::get().insert(ch, _account.sharedCode());
+		s << ch;
+	}
+	else
+		s << _account.codeHash();
+
+	_state.insert(_address, &s.out());
+}
 
-			_state.insert(i.first, &s.out());
+/// An account to be written by commitAccounts(), with the locations of its storage overlay to write (all of them,
+/// in key order, if null).
+struct AccountCommit
+{
+	Address address;
+	Account const* account;
+	std::set<u256> const* keys;
+};
+
+/// Write each of @a _accounts into the state trie @a _state in order, removing those that are dead. A storage trie
+/// is not touched at all if there is nothing to write to it. Storage tries are worked out concurrently on the thread
+/// pool, each staged apart from @a _db; only the writes to @a _db and @a _state are made one after another.
+template <class DB>
+void commitAccounts(std::vector<AccountCommit> const& _accounts, DB& _db, TrieDB<Address, DB>& _state)
+{
+	std::vector<size_t> touching;
+	for (size_t i = 0; i < _accounts.size(); ++i)
+		if (touchesStorage(*_accounts[i].account, _accounts[i].keys))
+			touching.push_back(i);
+
+	std::vector<std::unique_ptr<StagedDB<DB>>> staged(_accounts.size());
+	std::vector<h256> roots(_accounts.size());
+	ThreadPool::get().forEach(touching.size(), [&](size_t j)
+	{
+		size_t i = touching[j];
+		staged[i].reset(new StagedDB<DB>(&_db));
+		roots[i] = commitStorage(*_accounts[i].account, *staged[i], _accounts[i].keys);
+	});
+
+	for (size_t i = 0; i < _accounts.size(); ++i)
+	{
+		Account const& a = *_accounts[i].account;
+		if (staged[i])
+			staged[i]->replay(_db);
+		else if (a.isAlive())
+		{
+			assert(a.baseRoot());
+			roots[i] = a.baseRoot();
 		}
+		commitEntry(_accounts[i].address, a, roots[i], _db, _state);
+	}
+}
+
+template <class DB>
+void commit(std::map<Address, Account> const& _cache, DB& _db, TrieDB<Address, DB>& _state)
+{
+	std::vector<AccountCommit> accounts;
+	for (auto const& i: _cache)
+		accounts.push_back(AccountCommit{i.first, &i.second, nullptr});
+	commitAccounts(accounts, _db, _state);
 }
 
 }
@@ -0,0 +1,239 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file StateSnapshot.cpp
+ * @date 2015
+ */
+
+#include "StateSnapshot.h"
+#include <libdevcore/Log.h>
+#include <libdevcore/RLP.h>
+using namespace std;
+using namespace dev;
+using namespace dev::eth;
+
+bool StateSnapshot::s_enabled = false;
+Mutex StateSnapshot::x_snapshots;
+map<ldb::DB*, shared_ptr<StateSnapshot>> StateSnapshot::s_snapshots;
+
+namespace
+{
+
+static const char c_accountPrefix = 'a';
+static const char c_storagePrefix = 's';
+static const string c_rootKey = "snapshotRoot";
+static const unsigned c_rebuildBatch = 65536;	///< Entries written at once by rebuild().
+
+string accountKey(Address const& _a)
+{
+	return c_accountPrefix + string((char const*)_a.data(), _a.size);
+}
+
+string storageKey(Address const& _a, h256 const& _location)
+{
+	return c_storagePrefix + string((char const*)_a.data(), _a.size) + string((char const*)_location.data(), _location.size);
+}
+
+}
+
+StateSnapshot::StateSnapshot(ldb::DB* _db):
+	m_db(_db)
+{
+	string r;
+	if (m_db->Get(m_readOptions, c_rootKey, &r).ok() && r.size() == h256::size)
+		m_root = h256(r, h256::FromBinary);
+}
+
+void StateSnapshot::attach(ldb::DB* _db)
+{
+	Guard l(x_snapshots);
+	if (s_enabled && _db)
+		s_snapshots[_db] = make_shared<StateSnapshot>(_db);
+	else
+		s_snapshots.erase(_db);
+}
+
+shared_ptr<StateSnapshot> StateSnapshot::of(ldb::DB* _db)
+{
+	Guard l(x_snapshots);
+	auto it = s_snapshots.find(_db);
+	return it != s_snapshots.end() ? it->second : nullptr;
+}
+
+bool StateSnapshot::account(h256 const& _root, Address const& _a, string& o_rlp) const
+{
+	ReadGuard l(x_root);
+	if (!_root || _root != m_root)
+		return false;
+	string v;
+	auto s = m_db->Get(m_readOptions, accountKey(_a), &v);
+	if (!s.ok() && !s.IsNotFound())
+		return false;
+	o_rlp = v;
+	return true;
+}
+
+bool StateSnapshot::storage(h256 const& _root, Address const& _a, u256 const& _location, string& o_rlp) const
+{
+	ReadGuard l(x_root);
+	if (!_root || _root != m_root)
+		return false;
+	string v;
+	auto s = m_db->Get(m_readOptions, storageKey(_a, h256(_location)), &v);
+	if (!s.ok() && !s.IsNotFound())
+		return false;
+	o_rlp = v;
+	return true;
+}
+
+void StateSnapshot::eraseStorage(ldb::WriteBatch& _batch, Address const& _a) const
+{
+	string prefix = c_storagePrefix + string((char const*)_a.data(), _a.size);
+	unique_ptr<ldb::Iterator> it(m_db->NewIterator(m_readOptions));
+	for (it->Seek(prefix); it->Valid() && it->key().starts_with(prefix); it->Next())
+		if (it->key().size() == prefix.size() + h256::size)
+			_batch.Delete(it->key());
+}
+
+unsigned StateSnapshot::writeAccount(ldb::WriteBatch& _batch, Address const& _a, string const& _rlp, OverlayDB& _db) const
+{
+	if (_rlp.empty())
+	{
+		_batch.Delete(accountKey(_a));
+		return 1;
+	}
+	_batch.Put(accountKey(_a), _rlp);
+	unsigned ret = 1;
+	TrieDB<h256, OverlayDB> storageDB(&_db, RLP(_rlp)[2].toHash<h256>());
+	for (auto const& i: storageDB)
+	{
+		_batch.Put(storageKey(_a, i.first), ldb::Slice((char const*)i.second.data(), i.second.size()));
+		++ret;
+	}
+	return ret;
+}
+
+void StateSnapshot::write(ldb::WriteBatch& _batch, h256 const& _root)
+{
+	_batch.Put(c_rootKey, ldb::Slice((char const*)_root.data(), _root.size));
+	auto s = m_db->Write(m_writeOptions, &_batch);
+	if (s.ok())
+		m_root = _root;
+	else
+		cwarn << "Error writing state snapshot:" << s.ToString();
+}
+
+void StateSnapshot::advance(h256 const& _from, TrieDB<Address, OverlayDB> const& _state, OverlayDB& _db, set<Address> const& _whole, map<Address, set<u256>> const& _altered)
+{
+	WriteGuard l(x_root);
+	if (!_from || _from != m_root)
+		return;
+
+	ldb::WriteBatch batch;
+	for (auto const& a: _whole)
+	{
+		eraseStorage(batch, a);
+		writeAccount(batch, a, _state.at(a), _db);
+	}
+	for (auto const& i: _altered)
+		if (!_whole.count(i.first))
+		{
+			string s = _state.at(i.first);
+			if (s.empty())
+			{
+				eraseStorage(batch, i.first);
+				batch.Delete(accountKey(i.first));
+				continue;
+			}
+			batch.Put(accountKey(i.first), s);
+			if (i.second.empty())
+				continue;
+			TrieDB<h256, OverlayDB> storageDB(&_db, RLP(s)[2].toHash<h256>());
+			for (auto const& k: i.second)
+			{
+				string v = storageDB.at(k);
+				if (v.empty())
+					batch.Delete(storageKey(i.first, k));
+				else
+					batch.Put(storageKey(i.first, k), v);
+			}
+		}
+	write(batch, _state.root());
+}
+
+void StateSnapshot::rebuild(TrieDB<Address, OverlayDB> const& _state, OverlayDB& _db)
+{
+	Guard r(x_rebuild);
+	{
+		// Stop answering, on disk too, before any of it is overwritten. With no root, readers go to the trie and
+		// advance() does nothing, so neither need be kept out while we walk the state.
+		WriteGuard l(x_root);
+		if (m_root == _state.root())
+			return;
+		m_root = h256();
+		auto s = m_db->Delete(m_writeOptions, c_rootKey);
+		if (!s.ok())
+		{
+			// Left as it is on disk, it would be taken for the old root's when next opened.
+			cwarn << "Error clearing state snapshot root; not rebuilding:" << s.ToString();
+			return;
+		}
+	}
+	cnote << "Rebuilding state snapshot at" << _state.root();
+
+	// Written a piece at a time, so as not to hold the whole state in one batch. Should any piece fail, the
+	// snapshot is left without a root, so that it's never trusted; readers stay on the trie.
+	ldb::WriteBatch batch;
+	unsigned queued = 0;
+	bool failed = false;
+	auto flush = [&]()
+	{
+		if (queued < c_rebuildBatch)
+			return;
+		auto s = m_db->Write(m_writeOptions, &batch);
+		if (!s.ok())
+		{
+			cwarn << "Error writing state snapshot; abandoning rebuild:" << s.ToString();
+			failed = true;
+		}
+		batch.Clear();
+		queued = 0;
+	};
+
+	unique_ptr<ldb::Iterator> it(m_db->NewIterator(m_readOptions));
+	for (char p: {c_accountPrefix, c_storagePrefix})
+	{
+		unsigned size = p == c_accountPrefix ? 1 + Address::size : 1 + Address::size + h256::size;
+		for (it->Seek(string(1, p)); !failed && it->Valid() && it->key()[0] == p; it->Next())
+			if (it->key().size() == size)
+			{
+				batch.Delete(it->key());
+				++queued;
+				flush();
+			}
+	}
+	it.reset();
+	for (auto i = _state.begin(); !failed && i != _state.end(); ++i)
+	{
+		queued += writeAccount(batch, (*i).first, (*i).second.toString(), _db);
+		flush();
+	}
+	if (failed)
+		return;
+
+	WriteGuard l(x_root);
+	write(batch, _state.root());
+}
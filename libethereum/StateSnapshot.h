@@ -0,0 +1,106 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file StateSnapshot.h
+ * @date 2015
+ */
+
+#pragma once
+
+#include <map>
+#include <memory>
+#include <set>
+#include <libdevcore/Common.h>
+#include <libdevcore/Guards.h>
+#include <libdevcrypto/Common.h>
+#include <libdevcrypto/OverlayDB.h>
+#include <libdevcrypto/TrieDB.h>
+
+namespace dev
+{
+namespace eth
+{
+
+/**
+ * @brief Flat copy of the state at a single state root, kept in the state DB alongside the trie.
+ * Each account's trie entry is held under its address and each storage value under the address and location, so a
+ * read is one DB lookup rather than a walk down the trie. These keys are 21 and 53 bytes long, so they never clash
+ * with the 32-byte hashes of the trie nodes and code beside them.
+ *
+ * The snapshot records the root it reflects and answers only for that root; State works out which of its accounts
+ * are still as they were at that root. It is moved on by advance() as each block is committed on top of it, and
+ * rewritten by rebuild() should the chain move elsewhere.
+ */
+class StateSnapshot
+{
+public:
+	explicit StateSnapshot(ldb::DB* _db);
+
+	/// Keep a snapshot in each state DB opened from now on. Off by default.
+	static void setEnabled(bool _enabled) { s_enabled = _enabled; }
+	static bool isEnabled() { return s_enabled; }
+
+	/// Note that @a _db has been opened as a state DB, taking up the snapshot kept in it if snapshots are enabled.
+	static void attach(ldb::DB* _db);
+
+	/// @returns the snapshot kept in @a _db, or null if it has none.
+	static std::shared_ptr<StateSnapshot> of(ldb::DB* _db);
+
+	/// @returns the state root the snapshot reflects, or the null hash if it reflects none yet.
+	h256 root() const { ReadGuard l(x_root); return m_root; }
+
+	/// Read the trie entry for the account at @a _a into @a o_rlp, which is left empty if there is no such account.
+	/// @returns false, leaving @a o_rlp alone, unless the snapshot reflects state root @a _root.
+	bool account(h256 const& _root, Address const& _a, std::string& o_rlp) const;
+
+	/// Read the trie entry for storage location @a _location of the account at @a _a into @a o_rlp, as account().
+	bool storage(h256 const& _root, Address const& _a, u256 const& _location, std::string& o_rlp) const;
+
+	/// Move the snapshot on from state root @a _from to that of @a _state. Only the accounts in @a _whole, which may
+	/// differ in any way, and those in @a _altered, which differ at most in nonce, balance and the storage locations
+	/// listed, are rewritten. Nothing is done unless the snapshot reflects @a _from.
+	void advance(h256 const& _from, TrieDB<Address, OverlayDB> const& _state, OverlayDB& _db, std::set<Address> const& _whole, std::map<Address, std::set<u256>> const& _altered);
+
+	/// Rewrite the snapshot in full to reflect @a _state. Slow; the snapshot answers nothing until it's done, but
+	/// readers and advance() aren't held up by it.
+	void rebuild(TrieDB<Address, OverlayDB> const& _state, OverlayDB& _db);
+
+private:
+	/// Queue in @a _batch the removal of all storage values of the account at @a _a.
+	void eraseStorage(ldb::WriteBatch& _batch, Address const& _a) const;
+
+	/// Queue in @a _batch the writing of the account at @a _a, with trie entry @a _rlp, and of all its storage.
+	/// @returns the number of entries queued.
+	unsigned writeAccount(ldb::WriteBatch& _batch, Address const& _a, std::string const& _rlp, OverlayDB& _db) const;
+
+	/// Write @a _batch, which leaves the snapshot reflecting @a _root.
+	void write(ldb::WriteBatch& _batch, h256 const& _root);
+
+	ldb::DB* m_db;
+	ldb::ReadOptions m_readOptions;
+	ldb::WriteOptions m_writeOptions;
+
+	mutable SharedMutex x_root;		///< Held shared by readers, so that the snapshot can't move on mid-read.
+	h256 m_root;
+	Mutex x_rebuild;				///< Held throughout rebuild(), so that only one runs at once.
+
+	static bool s_enabled;
+	static Mutex x_snapshots;
+	static std::map<ldb::DB*, std::shared_ptr<StateSnapshot>> s_snapshots;
+};
+
+}
+}
@@ -22,6 +22,7 @@
 #include "TransactionQueue.h"
 
 #include <libdevcore/Log.h>
+#include <libdevcore/ThreadPool.h>
 #include <libethcore/Exceptions.h>
 #include "Transaction.h"
 using namespace std;
@@ -32,34 +33,84 @@ bool TransactionQueue::import(bytesConstRef _transactionRLP)
 {
 	// Check if we already know this transaction.
 	h256 h = sha3(_transactionRLP);
+	{
+		ReadGuard l(m_lock);
+		if (m_known.count(h))
+			return false;
+	}
 
-	UpgradableGuard l(m_lock);
-	if (m_known.count(h))
+	// Signature recovery is the expensive part; do it without holding the lock.
+	if (!isValid(_transactionRLP))
 		return false;
 
+	WriteGuard l(m_lock);
+	return insertVerified(h, _transactionRLP);
+}
+
+h256Set TransactionQueue::import(std::vector<bytesConstRef> const& _txs)
+{
+	h256s hashes;
+	hashes.reserve(_txs.size());
+	for (auto const& tx: _txs)
+		hashes.push_back(sha3(tx));
+
+	// Only bother checking those we don't know (and each only once).
+	vector<unsigned> todo;
+	{
+		h256Set seen;
+		ReadGuard l(m_lock);
+		for (unsigned i = 0; i < _txs.size(); ++i)
+			if (!m_known.count(hashes[i]) && seen.insert(hashes[i]).second)
+				todo.push_back(i);
+	}
+
+	vector<char> valid(todo.size(), 0);
+	ThreadPool::get().forEach(todo.size(), [&](size_t i)
+	{
+		valid[i] = isValid(_txs[todo[i]]);
+	});
+
+	h256Set ret;
+	WriteGuard l(m_lock);
+	for (unsigned i = 0; i < todo.size(); ++i)
+		if (valid[i] && insertVerified(hashes[todo[i]], _txs[todo[i]]))
+			ret.insert(hashes[todo[i]]);
+	return ret;
+}
+
+bool TransactionQueue::isValid(bytesConstRef _transactionRLP)
+{
 	try
 	{
 		// Check validity of _transactionRLP as a transaction. To do this we just deserialise and attempt to determine the sender.
 		// If it doesn't work, the signature is bad.
 		// The transaction's nonce may yet be invalid (or, it could be "valid" but we may be missing a marginally older transaction).
 		Transaction t(_transactionRLP, true);
-
-		UpgradeGuard ul(l);
-		// If valid, append to blocks.
-		m_current[h] = _transactionRLP.toBytes();
-		m_known.insert(h);
+		return true;
 	}
 	catch (Exception const& _e)
 	{
 		cwarn << "Ignoring invalid transaction: " <<  diagnostic_information(_e);
-		return false;
 	}
 	catch (std::exception const& _e)
 	{
 		cwarn << "Ignoring invalid transaction: " << _e.what();
-		return false;
 	}
+	return false;
+}
+
+bool TransactionQueue::insertVerified(h256 const& _h, bytesConstRef _transactionRLP)
+{
+	// Someone may have beaten us to it while we were checking the signature.
+	if (m_known.count(_h))
+		return false;
 
+	// If valid, append to blocks.
+	m_current[_h] = _transactionRLP.toBytes();
+	m_known.insert(_h);
+	noteReady(_h);
+	if (m_onReady)
+		m_onReady();
 	return true;
 }
 
@@ -69,6 +120,7 @@ void TransactionQueue::setFuture(std::pair<h256, bytes> const& _t)
 	if (m_current.count(_t.first))
 	{
 		m_current.erase(_t.first);
+		noteUnready(_t.first);
 		m_unknown.insert(make_pair(Transaction(_t.second).sender(), _t));
 	}
 }
@@ -77,9 +129,14 @@ void TransactionQueue::noteGood(std::pair<h256, bytes> const& _t)
 {
 	WriteGuard l(m_lock);
 	auto r = m_unknown.equal_range(Transaction(_t.second).sender());
+	if (r.first == r.second)
+		return;
 	for (auto it = r.first; it != r.second; ++it)
-		m_current.insert(it->second);
+		if (m_current.insert(it->second).second)
+			noteReady(it->second.first);
 	m_unknown.erase(r.first, r.second);
+	if (m_onReady)
+		m_onReady();
 }
 
 void TransactionQueue::drop(h256 _txHash)
@@ -93,7 +150,10 @@ void TransactionQueue::drop(h256 _txHash)
 	m_known.erase(_txHash);
 
 	if (m_current.count(_txHash))
+	{
 		m_current.erase(_txHash);
+		noteUnready(_txHash);
+	}
 	else
 	{
 		for (auto i = m_unknown.begin(); i != m_unknown.end(); ++i)
@@ -104,3 +164,30 @@ void TransactionQueue::drop(h256 _txHash)
 			}
 	}
 }
+
+void TransactionQueue::noteReady(h256 const& _h)
+{
+	noteUnready(_h);
+	m_readyOrder[++m_sequence] = _h;
+	m_readyAt[_h] = m_sequence;
+}
+
+void TransactionQueue::noteUnready(h256 const& _h)
+{
+	auto it = m_readyAt.find(_h);
+	if (it != m_readyAt.end())
+	{
+		m_readyOrder.erase(it->second);
+		m_readyAt.erase(it);
+	}
+}
+
+map<unsigned, pair<h256, bytes>> TransactionQueue::transactionsSince(unsigned _since, unsigned& o_now) const
+{
+	map<unsigned, pair<h256, bytes>> ret;
+	ReadGuard l(m_lock);
+	for (auto it = m_readyOrder.upper_bound(_since); it != m_readyOrder.end(); ++it)
+		ret.insert(ret.end(), make_pair(it->first, make_pair(it->second, m_current.at(it->second))));
+	o_now = m_sequence;
+	return ret;
+}
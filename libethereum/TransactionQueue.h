@@ -21,6 +21,7 @@
 
 #pragma once
 
+#include <functional>
 #include <boost/thread.hpp>
 #include <libdevcore/Common.h>
 #include "libethcore/CommonEth.h"
@@ -43,22 +44,46 @@ public:
 	bool attemptImport(bytesConstRef _tx) { try { import(_tx); return true; } catch (...) { return false; } }
 	bool attemptImport(bytes const& _tx) { return attemptImport(&_tx); }
 	bool import(bytesConstRef _tx);
+	/// Import a batch of transactions, recovering their senders in parallel. The queue is only locked for writing once
+	/// all signatures are checked. @returns the hashes of those transactions that were new and valid.
+	h256Set import(std::vector<bytesConstRef> const& _txs);
 
 	void drop(h256 _txHash);
 
 	std::map<h256, bytes> transactions() const { ReadGuard l(m_lock); return m_current; }
+	/// @returns the current transactions that became ready after the sequence point @a _since, keyed by the point at
+	/// which each did. @a o_now is set to the latest sequence point, to be passed as @a _since next time.
+	std::map<unsigned, std::pair<h256, bytes>> transactionsSince(unsigned _since, unsigned& o_now) const;
+	/// @returns the latest sequence point; any transaction becoming ready from now on will come after it.
+	unsigned sequence() const { ReadGuard l(m_lock); return m_sequence; }
 	std::pair<unsigned, unsigned> items() const { ReadGuard l(m_lock); return std::make_pair(m_current.size(), m_unknown.size()); }
 
 	void setFuture(std::pair<h256, bytes> const& _t);
 	void noteGood(std::pair<h256, bytes> const& _t);
 
-	void clear() { WriteGuard l(m_lock); m_known.clear(); m_current.clear(); m_unknown.clear(); }
+	void clear() { WriteGuard l(m_lock); m_known.clear(); m_current.clear(); m_unknown.clear(); m_readyOrder.clear(); m_readyAt.clear(); }
+
+	/// Register a handler called whenever transactions become ready for inclusion in a block.
+	/// It is called with the queue locked, so it must be quick and must not call back into the queue.
+	void onReady(std::function<void()> const& _t) { m_onReady = _t; }
 
 private:
+	/// @returns true if @a _tx is a well-formed transaction with a valid signature. Slow; call without holding m_lock.
+	static bool isValid(bytesConstRef _tx);
+	/// Adds the already verified @a _tx to the current set unless it is known. Expects m_lock to be write-locked.
+	bool insertVerified(h256 const& _h, bytesConstRef _tx);
+	/// Records that @a _h has just become current (or is no longer). Expects m_lock to be write-locked.
+	void noteReady(h256 const& _h);
+	void noteUnready(h256 const& _h);
+
 	mutable boost::shared_mutex m_lock;							///< General lock.
 	std::set<h256> m_known;										///< Hashes of transactions in both sets.
 	std::map<h256, bytes> m_current;							///< Map of SHA3(tx) to tx.
 	std::multimap<Address, std::pair<h256, bytes>> m_unknown;	///< For transactions that have a future nonce; we map their sender address to the tx stuff, and insert once the sender has a valid TX.
+	unsigned m_sequence = 0;									///< Bumped each time a transaction becomes current.
+	std::map<unsigned, h256> m_readyOrder;						///< The current transactions by the sequence point at which they became so.
+	std::map<h256, unsigned> m_readyAt;							///< Reverse of m_readyOrder.
+	std::function<void()> m_onReady;							///< Called when transactions become ready.
 };
 
 }
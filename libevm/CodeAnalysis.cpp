@@ -0,0 +1,63 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file CodeAnalysis.cpp
+ * @date 2015
+ */
+
+#include "CodeAnalysis.h"
+#include <libevmcore/Instruction.h>
+using namespace std;
+using namespace dev;
+using namespace dev::eth;
+
+SharedMutex CodeAnalysis::x_cache;
+unordered_map<h256, shared_ptr<CodeAnalysis const>> CodeAnalysis::s_cache;
+
+CodeAnalysis::CodeAnalysis(bytesConstRef _code):
+	m_jumpDests(_code.size(), false),
+	m_pushIndex(_code.size(), 0)
+{
+	for (unsigned i = 0; i < _code.size(); ++i)
+		if (_code[i] == (byte)Instruction::JUMPDEST)
+			m_jumpDests[i] = true;
+		else if (_code[i] >= (byte)Instruction::PUSH1 && _code[i] <= (byte)Instruction::PUSH32)
+		{
+			unsigned n = _code[i] - (unsigned)Instruction::PUSH1 + 1;
+			u256 v = 0;
+			for (unsigned j = i + 1; j <= i + n; ++j)
+				v = (v << 8) | (j < _code.size() ? _code[j] : 0);
+			m_pushIndex[i] = m_pushValues.size();
+			m_pushValues.push_back(v);
+			i += n;
+		}
+}
+
+shared_ptr<CodeAnalysis const> CodeAnalysis::get(h256 const& _codeHash, bytesConstRef _code)
+{
+	{
+		ReadGuard l(x_cache);
+		auto it = s_cache.find(_codeHash);
+		if (it != s_cache.end())
+			return it->second;
+	}
+
+	auto ret = make_shared<CodeAnalysis const>(_code);
+	WriteGuard l(x_cache);
+	if (s_cache.size() >= c_maxCached)
+		s_cache.clear();
+	return s_cache.insert(make_pair(_codeHash, ret)).first->second;
+}
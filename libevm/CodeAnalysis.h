@@ -0,0 +1,68 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file CodeAnalysis.h
+ * @date 2015
+ */
+
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <unordered_map>
+#include <libdevcore/Common.h>
+#include <libdevcore/FixedHash.h>
+#include <libdevcore/Guards.h>
+
+namespace dev
+{
+namespace eth
+{
+
+/**
+ * @brief Facts about a piece of EVM code that depend only on the code itself.
+ * Since code is immutable, these may be worked out once and shared by every execution of it; use get() to find the
+ * shared analysis of an account's code by its hash.
+ */
+class CodeAnalysis
+{
+public:
+	/// Analyse @a _code.
+	explicit CodeAnalysis(bytesConstRef _code);
+
+	/// @returns the shared analysis of @a _code, whose hash is @a _codeHash, analysing it if it's not yet known.
+	static std::shared_ptr<CodeAnalysis const> get(h256 const& _codeHash, bytesConstRef _code);
+
+	/// @returns true iff @a _pc is the position of a JUMPDEST instruction (rather than of some PUSH data).
+	bool isJumpDest(u256 const& _pc) const { return _pc < m_jumpDests.size() && m_jumpDests[(size_t)_pc]; }
+
+	/// @returns the value pushed by the PUSH instruction at @a _pc. Data running off the end of the code is taken as zero.
+	u256 const& pushValue(u256 const& _pc) const { return m_pushValues[m_pushIndex[(size_t)_pc]]; }
+
+	/// Size limit (in entries) of the shared cache of analyses. It's cleared whenever it grows beyond this.
+	static const unsigned c_maxCached = 4096;
+
+private:
+	std::vector<bool> m_jumpDests;		///< Whether each code position is a JUMPDEST.
+	std::vector<unsigned> m_pushIndex;	///< For each position of a PUSH instruction, the index of its value in m_pushValues.
+	u256s m_pushValues;					///< The values of all PUSH instructions in code order.
+
+	static SharedMutex x_cache;
+	static std::unordered_map<h256, std::shared_ptr<CodeAnalysis const>> s_cache;
+};
+
+}
+}
@@ -25,26 +25,200 @@
 using namespace dev;
 using namespace dev::eth;
 
+namespace
+{
+
+/// Operands (offsets, sizes, call gas) no bigger than this have all their fees reckoned in 64 bits.
+static const uint64_t c_maxFastOperand = (uint64_t)1 << 32;
+
+/// The fee schedule narrowed to native words, so the common path needn't touch u256.
+struct FastFees
+{
+	FastFees():
+		step((uint64_t)c_stepGas), balance((uint64_t)c_balanceGas), sha3((uint64_t)c_sha3Gas), sha3Word((uint64_t)c_sha3WordGas),
+		sload((uint64_t)c_sloadGas), sstoreSet((uint64_t)c_sstoreSetGas), sstoreReset((uint64_t)c_sstoreResetGas),
+		create((uint64_t)c_createGas), call((uint64_t)c_callGas), exp((uint64_t)c_expGas), expByte((uint64_t)c_expByteGas),
+		memory((uint64_t)c_memoryGas), log((uint64_t)c_logGas), logData((uint64_t)c_logDataGas), logTopic((uint64_t)c_logTopicGas),
+		copy((uint64_t)c_copyGas)
+	{}
+
+	uint64_t step;
+	uint64_t balance;
+	uint64_t sha3;
+	uint64_t sha3Word;
+	uint64_t sload;
+	uint64_t sstoreSet;
+	uint64_t sstoreReset;
+	uint64_t create;
+	uint64_t call;
+	uint64_t exp;
+	uint64_t expByte;
+	uint64_t memory;
+	uint64_t log;
+	uint64_t logData;
+	uint64_t logTopic;
+	uint64_t copy;
+};
+
+FastFees const& fastFees()
+{
+	static const FastFees s_fees;
+	return s_fees;
+}
+
+/// The threaded interpreter's handlers that each implement a single instruction.
+#define ETH_VM_INSTRUCTION_HANDLERS(X) \
+	X(STOP) X(ADD) X(MUL) X(SUB) X(DIV) X(SDIV) X(MOD) X(SMOD) X(ADDMOD) X(MULMOD) X(EXP) X(SIGNEXTEND) \
+	X(LT) X(GT) X(SLT) X(SGT) X(EQ) X(ISZERO) X(AND) X(OR) X(XOR) X(NOT) X(BYTE) X(SHA3) \
+	X(ADDRESS) X(BALANCE) X(ORIGIN) X(CALLER) X(CALLVALUE) X(CALLDATALOAD) X(CALLDATASIZE) X(CALLDATACOPY) \
+	X(CODESIZE) X(CODECOPY) X(GASPRICE) X(EXTCODESIZE) X(EXTCODECOPY) \
+	X(BLOCKHASH) X(COINBASE) X(TIMESTAMP) X(NUMBER) X(DIFFICULTY) X(GASLIMIT) \
+	X(POP) X(MLOAD) X(MSTORE) X(MSTORE8) X(SLOAD) X(SSTORE) X(JUMP) X(JUMPI) X(PC) X(MSIZE) X(GAS) X(JUMPDEST) \
+	X(CREATE) X(CALL) X(RETURN) X(SUICIDE)
+
+/// All of the threaded interpreter's handlers; the PUSHes, DUPs, SWAPs and LOGs each share one, as do CALL
+/// and CALLCODE. BAD takes every undefined opcode.
+#define ETH_VM_HANDLERS(X) X(BAD) X(PUSH) X(DUP) X(SWAP) X(LOG) ETH_VM_INSTRUCTION_HANDLERS(X)
+
+#define ETH_VM_HANDLER_ID(Name) H_ ## Name,
+enum Handler: byte { ETH_VM_HANDLERS(ETH_VM_HANDLER_ID) HandlerCount };
+#undef ETH_VM_HANDLER_ID
+
+Handler handlerOf(Instruction _inst)
+{
+	if (_inst >= Instruction::PUSH1 && _inst <= Instruction::PUSH32)
+		return H_PUSH;
+	if (_inst >= Instruction::DUP1 && _inst <= Instruction::DUP16)
+		return H_DUP;
+	if (_inst >= Instruction::SWAP1 && _inst <= Instruction::SWAP16)
+		return H_SWAP;
+	if (_inst >= Instruction::LOG0 && _inst <= Instruction::LOG4)
+		return H_LOG;
+	if (_inst == Instruction::CALLCODE)
+		return H_CALL;
+	switch (_inst)
+	{
+#define ETH_VM_HANDLER_CASE(Name) case Instruction::Name: return H_ ## Name;
+	ETH_VM_INSTRUCTION_HANDLERS(ETH_VM_HANDLER_CASE)
+#undef ETH_VM_HANDLER_CASE
+	default:
+		return H_BAD;
+	}
+}
+
+/// Maps every opcode to its entry in @a _handlers, indexed by Handler.
+template <class T> std::array<T, 256> dispatchTable(T const* _handlers)
+{
+	std::array<T, 256> ret;
+	for (unsigned i = 0; i < 256; ++i)
+		ret[i] = _handlers[handlerOf((Instruction)i)];
+	return ret;
+}
+
+}
+
 void VM::reset(u256 _gas) noexcept
 {
 	VMFace::reset(_gas);
 	m_curPC = 0;
-	m_jumpDests.clear();
+	m_stack.clear();
+	m_code.reset();
+	m_onFail = nullptr;
+	// Memory starts out empty, but its buffer is kept for the next run unless it grew unusually large.
+	if (m_temp.capacity() > c_retainedMemory)
+		bytes().swap(m_temp);
+	else
+		m_temp.clear();
 }
 
-bytesConstRef VM::go(ExtVMFace& _ext, OnOpFunc const& _onOp, uint64_t _steps)
+bigint VM::wideGas(Instruction _inst, bigint& o_newTempSize) const
 {
 	auto memNeed = [](u256 _offset, dev::u256 _size) { return _size ? (bigint)_offset + _size : (bigint)0; };
 	auto gasForMem = [](bigint _size) -> bigint { bigint s = _size / 32; return (bigint)c_memoryGas * (s + s * s / 1024); };
 
-	if (m_jumpDests.empty())
-		for (unsigned i = 0; i < _ext.code.size(); ++i)
-		{
-			if (_ext.code[i] == (byte)Instruction::JUMPDEST)
-				m_jumpDests.insert(i);
-			else if (_ext.code[i] >= (byte)Instruction::PUSH1 && _ext.code[i] <= (byte)Instruction::PUSH32)
-				i += _ext.code[i] - (unsigned)Instruction::PUSH1 + 1;
-		}
+	bigint runGas = c_stepGas;
+	bigint copySize = 0;
+	o_newTempSize = m_temp.size();
+
+	switch (_inst)
+	{
+	case Instruction::MSTORE:
+	case Instruction::MLOAD:
+		o_newTempSize = (bigint)m_stack.back() + 32;
+		break;
+	case Instruction::MSTORE8:
+		o_newTempSize = (bigint)m_stack.back() + 1;
+		break;
+	case Instruction::RETURN:
+		o_newTempSize = memNeed(m_stack.back(), m_stack[m_stack.size() - 2]);
+		break;
+	case Instruction::SHA3:
+		runGas = c_sha3Gas + (m_stack[m_stack.size() - 2] + 31) / 32 * c_sha3WordGas;
+		o_newTempSize = memNeed(m_stack.back(), m_stack[m_stack.size() - 2]);
+		break;
+	case Instruction::CALLDATACOPY:
+	case Instruction::CODECOPY:
+		copySize = m_stack[m_stack.size() - 3];
+		o_newTempSize = memNeed(m_stack.back(), m_stack[m_stack.size() - 3]);
+		break;
+	case Instruction::EXTCODECOPY:
+		copySize = m_stack[m_stack.size() - 4];
+		o_newTempSize = memNeed(m_stack[m_stack.size() - 2], m_stack[m_stack.size() - 4]);
+		break;
+	case Instruction::LOG0:
+	case Instruction::LOG1:
+	case Instruction::LOG2:
+	case Instruction::LOG3:
+	case Instruction::LOG4:
+	{
+		unsigned n = (unsigned)_inst - (unsigned)Instruction::LOG0;
+		runGas = c_logGas + c_logTopicGas * n + (bigint)c_logDataGas * m_stack[m_stack.size() - 2];
+		o_newTempSize = memNeed(m_stack[m_stack.size() - 1], m_stack[m_stack.size() - 2]);
+		break;
+	}
+	case Instruction::CALL:
+	case Instruction::CALLCODE:
+		runGas = (bigint)c_callGas + m_stack[m_stack.size() - 1];
+		o_newTempSize = std::max(memNeed(m_stack[m_stack.size() - 6], m_stack[m_stack.size() - 7]), memNeed(m_stack[m_stack.size() - 4], m_stack[m_stack.size() - 5]));
+		break;
+	case Instruction::CREATE:
+		runGas = c_createGas;
+		o_newTempSize = memNeed(m_stack[m_stack.size() - 2], m_stack[m_stack.size() - 3]);
+		break;
+	default:
+		break;
+	}
+
+	o_newTempSize = (o_newTempSize + 31) / 32 * 32;
+	if (o_newTempSize > m_temp.size())
+		runGas += gasForMem(o_newTempSize) - gasForMem(m_temp.size());
+	runGas += c_copyGas * (copySize + 31) / 32;
+	return runGas;
+}
+
+void VM::copyToMemory(bytesConstRef _data)
+{
+	unsigned offset = (unsigned)m_stack.back();
+	m_stack.pop_back();
+	u256 index = m_stack.back();
+	m_stack.pop_back();
+	unsigned size = (unsigned)m_stack.back();
+	m_stack.pop_back();
+	unsigned sizeToBeCopied = index + (bigint)size > (u256)_data.size() ? (u256)_data.size() < index ? 0 : _data.size() - (unsigned)index : size;
+	memcpy(m_temp.data() + offset, _data.data() + (unsigned)index, sizeToBeCopied);
+	memset(m_temp.data() + offset + sizeToBeCopied, 0, size - sizeToBeCopied);
+}
+
+bytesConstRef VM::go(ExtVMFace& _ext, OnOpFunc const& _onOp, uint64_t _steps)
+{
+	if (m_threaded)
+		return _onOp ? goThreaded<true>(_ext, _onOp, _steps) : goThreaded<false>(_ext, _onOp, _steps);
+
+	FastFees const& fees = fastFees();
+	auto gasForMem = [&](uint64_t _size) -> uint64_t { uint64_t s = _size / 32; return fees.memory * (s + s * s / 1024); };
+
+	if (!m_code)
+		m_code = _ext.codeHash ? CodeAnalysis::get(_ext.codeHash, &_ext.code) : std::make_shared<CodeAnalysis const>(&_ext.code);
 	u256 nextPC = m_curPC + 1;
 	auto osteps = _steps;
 	for (bool stopped = false; !stopped && _steps--; m_curPC = nextPC, nextPC = m_curPC + 1)
@@ -53,14 +227,20 @@ bytesConstRef VM::go(ExtVMFace& _ext, OnOpFunc const& _onOp, uint64_t _steps)
 		Instruction inst = (Instruction)_ext.getCode(m_curPC);
 
 		// FEES...
-		bigint runGas = c_stepGas;
-		bigint newTempSize = m_temp.size();
-		bigint copySize = 0;
+		// Reckoned in 64 bits; should any operand be too wide for that, the instruction is flagged
+		// and its fee worked out exactly by wideGas() instead.
+		uint64_t runGas = fees.step;
+		uint64_t newTempSize = m_temp.size();
+		uint64_t copySize = 0;
+		bool wide = newTempSize > c_maxFastOperand;
+
+		auto narrow = [&](u256 const& _v) -> uint64_t { if (_v > c_maxFastOperand) { wide = true; return 0; } return (uint64_t)_v; };
+		auto memNeed = [&](u256 const& _offset, u256 const& _size) -> uint64_t { return _size ? narrow(_offset) + narrow(_size) : 0; };
 
 		auto onOperation = [&]()
 		{
 			if (_onOp)
-				_onOp(osteps - _steps - 1, inst, newTempSize > m_temp.size() ? (newTempSize - m_temp.size()) / 32 : bigint(0), runGas, this, &_ext);
+				_onOp(osteps - _steps - 1, inst, newTempSize > m_temp.size() ? (newTempSize - m_temp.size()) / 32 : 0, runGas, this, &_ext);
 		};
 		// should work, but just seems to result in immediate errorless exit on initial execution. yeah. weird.
 		//m_onFail = std::function<void()>(onOperation);
@@ -79,33 +259,33 @@ bytesConstRef VM::go(ExtVMFace& _ext, OnOpFunc const& _onOp, uint64_t _steps)
 		case Instruction::SSTORE:
 			require(2);
 			if (!_ext.store(m_stack.back()) && m_stack[m_stack.size() - 2])
-				runGas = c_sstoreSetGas;
+				runGas = fees.sstoreSet;
 			else if (_ext.store(m_stack.back()) && !m_stack[m_stack.size() - 2])
 			{
 				runGas = 0;
 				_ext.sub.refunds += c_sstoreRefundGas;
 			}
 			else
-				runGas = c_sstoreResetGas;
+				runGas = fees.sstoreReset;
 			break;
 
 		case Instruction::SLOAD:
 			require(1);
-			runGas = c_sloadGas;
+			runGas = fees.sload;
 			break;
 
 		// These all operate on memory and therefore potentially expand it:
 		case Instruction::MSTORE:
 			require(2);
-			newTempSize = (bigint)m_stack.back() + 32;
+			newTempSize = memNeed(m_stack.back(), 32);
 			break;
 		case Instruction::MSTORE8:
 			require(2);
-			newTempSize = (bigint)m_stack.back() + 1;
+			newTempSize = memNeed(m_stack.back(), 1);
 			break;
 		case Instruction::MLOAD:
 			require(1);
-			newTempSize = (bigint)m_stack.back() + 32;
+			newTempSize = memNeed(m_stack.back(), 32);
 			break;
 		case Instruction::RETURN:
 			require(2);
@@ -113,28 +293,28 @@ bytesConstRef VM::go(ExtVMFace& _ext, OnOpFunc const& _onOp, uint64_t _steps)
 			break;
 		case Instruction::SHA3:
 			require(2);
-			runGas = c_sha3Gas + (m_stack[m_stack.size() - 2] + 31) / 32 * c_sha3WordGas;
+			runGas = fees.sha3 + (narrow(m_stack[m_stack.size() - 2]) + 31) / 32 * fees.sha3Word;
 			newTempSize = memNeed(m_stack.back(), m_stack[m_stack.size() - 2]);
 			break;
 		case Instruction::CALLDATACOPY:
 			require(3);
-			copySize = m_stack[m_stack.size() - 3];
+			copySize = narrow(m_stack[m_stack.size() - 3]);
 			newTempSize = memNeed(m_stack.back(), m_stack[m_stack.size() - 3]);
 			break;
 		case Instruction::CODECOPY:
 			require(3);
-			copySize = m_stack[m_stack.size() - 3];
+			copySize = narrow(m_stack[m_stack.size() - 3]);
 			newTempSize = memNeed(m_stack.back(), m_stack[m_stack.size() - 3]);
 			break;
 		case Instruction::EXTCODECOPY:
 			require(4);
-			copySize = m_stack[m_stack.size() - 4];
+			copySize = narrow(m_stack[m_stack.size() - 4]);
 			newTempSize = memNeed(m_stack[m_stack.size() - 2], m_stack[m_stack.size() - 4]);
 			break;
 
 		case Instruction::BALANCE:
 			require(1);
-			runGas = c_balanceGas;
+			runGas = fees.balance;
 			break;
 		case Instruction::LOG0:
 		case Instruction::LOG1:
@@ -144,7 +324,7 @@ bytesConstRef VM::go(ExtVMFace& _ext, OnOpFunc const& _onOp, uint64_t _steps)
 		{
 			unsigned n = (unsigned)inst - (unsigned)Instruction::LOG0;
 			require(n + 2);
-			runGas = c_logGas + c_logTopicGas * n + (bigint)c_logDataGas * m_stack[m_stack.size() - 2];
+			runGas = fees.log + fees.logTopic * n + fees.logData * narrow(m_stack[m_stack.size() - 2]);
 			newTempSize = memNeed(m_stack[m_stack.size() - 1], m_stack[m_stack.size() - 2]);
 			break;
 		}
@@ -152,7 +332,7 @@ bytesConstRef VM::go(ExtVMFace& _ext, OnOpFunc const& _onOp, uint64_t _steps)
 		case Instruction::CALL:
 		case Instruction::CALLCODE:
 			require(7);
-			runGas = (bigint)c_callGas + m_stack[m_stack.size() - 1];
+			runGas = fees.call + narrow(m_stack[m_stack.size() - 1]);
 			newTempSize = std::max(memNeed(m_stack[m_stack.size() - 6], m_stack[m_stack.size() - 7]), memNeed(m_stack[m_stack.size() - 4], m_stack[m_stack.size() - 5]));
 			break;
 
@@ -160,14 +340,14 @@ bytesConstRef VM::go(ExtVMFace& _ext, OnOpFunc const& _onOp, uint64_t _steps)
 		{
 			require(3);
 			newTempSize = memNeed(m_stack[m_stack.size() - 2], m_stack[m_stack.size() - 3]);
-			runGas = c_createGas;
+			runGas = fees.create;
 			break;
 		}
 		case Instruction::EXP:
 		{
 			require(2);
 			auto expon = m_stack[m_stack.size() - 2];
-			runGas = c_expGas + c_expByteGas * (32 - (h256(expon).firstBitSet() / 8));
+			runGas = fees.exp + fees.expByte * (32 - (h256(expon).firstBitSet() / 8));
 			break;
 		}
 
@@ -296,26 +476,46 @@ bytesConstRef VM::go(ExtVMFace& _ext, OnOpFunc const& _onOp, uint64_t _steps)
 			BOOST_THROW_EXCEPTION(BadInstruction());
 		}
 
-		newTempSize = (newTempSize + 31) / 32 * 32;
-		if (newTempSize > m_temp.size())
-			runGas += gasForMem(newTempSize) - gasForMem(m_temp.size());
-		runGas += c_copyGas * (copySize + 31) / 32;
+		if (wide)
+		{
+			bigint wideTempSize;
+			bigint wideRunGas = wideGas(inst, wideTempSize);
+			if (_onOp)
+				_onOp(osteps - _steps - 1, inst, wideTempSize > m_temp.size() ? (wideTempSize - m_temp.size()) / 32 : bigint(0), wideRunGas, this, &_ext);
 
-		onOperation();
-//		if (_onOp)
-//			_onOp(osteps - _steps - 1, inst, newTempSize > m_temp.size() ? (newTempSize - m_temp.size()) / 32 : bigint(0), runGas, this, &_ext);
+			if (m_gas < wideRunGas)
+			{
+				// Out of gas!
+				m_gas = 0;
+				BOOST_THROW_EXCEPTION(OutOfGas());
+			}
 
-		if (m_gas < runGas)
-		{
-			// Out of gas!
-			m_gas = 0;
-			BOOST_THROW_EXCEPTION(OutOfGas());
+			m_gas = (u256)((bigint)m_gas - wideRunGas);
+
+			if (wideTempSize > m_temp.size())
+				m_temp.resize((size_t)wideTempSize);
 		}
+		else
+		{
+			newTempSize = (newTempSize + 31) / 32 * 32;
+			if (newTempSize > m_temp.size())
+				runGas += gasForMem(newTempSize) - gasForMem(m_temp.size());
+			runGas += fees.copy * (copySize + 31) / 32;
+
+			onOperation();
 
-		m_gas = (u256)((bigint)m_gas - runGas);
+			if (m_gas < runGas)
+			{
+				// Out of gas!
+				m_gas = 0;
+				BOOST_THROW_EXCEPTION(OutOfGas());
+			}
 
-		if (newTempSize > m_temp.size())
-			m_temp.resize((size_t)newTempSize);
+			m_gas -= runGas;
+
+			if (newTempSize > m_temp.size())
+				m_temp.resize((size_t)newTempSize);
+		}
 
 		// EXECUTE...
 		switch (inst)
@@ -565,11 +765,8 @@ bytesConstRef VM::go(ExtVMFace& _ext, OnOpFunc const& _onOp, uint64_t _steps)
 		case Instruction::PUSH31:
 		case Instruction::PUSH32:
 		{
-			int i = (int)inst - (int)Instruction::PUSH1 + 1;
-			nextPC = m_curPC + 1;
-			m_stack.push_back(0);
-			for (; i--; nextPC++)
-				m_stack.back() = (m_stack.back() << 8) | _ext.getCode(nextPC);
+			m_stack.push_back(m_code->pushValue(m_curPC));
+			nextPC = m_curPC + 1 + ((int)inst - (int)Instruction::PUSH1 + 1);
 			break;
 		}
 		case Instruction::POP:
@@ -648,7 +845,7 @@ bytesConstRef VM::go(ExtVMFace& _ext, OnOpFunc const& _onOp, uint64_t _steps)
 			break;
 		case Instruction::JUMP:
 			nextPC = m_stack.back();
-			if (!m_jumpDests.count(nextPC))
+			if (!m_code->isJumpDest(nextPC))
 				BOOST_THROW_EXCEPTION(BadJumpDestination());
 			m_stack.pop_back();
 			break;
@@ -656,7 +853,7 @@ bytesConstRef VM::go(ExtVMFace& _ext, OnOpFunc const& _onOp, uint64_t _steps)
 			if (m_stack[m_stack.size() - 2])
 			{
 				nextPC = m_stack.back();
-				if (!m_jumpDests.count(nextPC))
+				if (!m_code->isJumpDest(nextPC))
 					BOOST_THROW_EXCEPTION(BadJumpDestination());
 			}
 			m_stack.pop_back();
@@ -794,3 +991,641 @@ bytesConstRef VM::go(ExtVMFace& _ext, OnOpFunc const& _onOp, uint64_t _steps)
 		BOOST_THROW_EXCEPTION(StepsDone());
 	return bytesConstRef();
 }
+
+#if defined(__GNUC__)
+#define ETH_COMPUTED_GOTO 1
+#else
+#define ETH_COMPUTED_GOTO 0
+#endif
+
+#define ETH_FETCH \
+	if (!_steps--) \
+	{ \
+		m_curPC = pc; \
+		BOOST_THROW_EXCEPTION(StepsDone()); \
+	} \
+	inst = pc < code.size() ? (Instruction)code[(size_t)pc] : Instruction::STOP; \
+	if (Trace) \
+		m_curPC = pc;
+
+#if ETH_COMPUTED_GOTO
+#define ETH_CASE(Name) L_ ## Name:
+#define ETH_DISPATCH { ETH_FETCH goto *s_table[(byte)inst]; }
+#else
+#define ETH_CASE(Name) case H_ ## Name:
+#define ETH_DISPATCH goto l_dispatch;
+#endif
+#define ETH_NEXT { ++pc; ETH_DISPATCH }
+
+template <bool Trace>
+bytesConstRef VM::goThreaded(ExtVMFace& _ext, OnOpFunc const& _onOp, uint64_t _steps)
+{
+#if ETH_COMPUTED_GOTO
+#define ETH_VM_LABEL(Name) &&L_ ## Name,
+	static void* const c_handlers[] = { ETH_VM_HANDLERS(ETH_VM_LABEL) };
+#undef ETH_VM_LABEL
+	static std::array<void*, 256> const s_table = dispatchTable(c_handlers);
+#else
+#define ETH_VM_ID(Name) H_ ## Name,
+	static Handler const c_handlers[] = { ETH_VM_HANDLERS(ETH_VM_ID) };
+#undef ETH_VM_ID
+	static std::array<Handler, 256> const s_table = dispatchTable(c_handlers);
+#endif
+
+	FastFees const& fees = fastFees();
+	auto gasForMem = [&](uint64_t _size) -> uint64_t { uint64_t s = _size / 32; return fees.memory * (s + s * s / 1024); };
+
+	if (!m_code)
+		m_code = _ext.codeHash ? CodeAnalysis::get(_ext.codeHash, &_ext.code) : std::make_shared<CodeAnalysis const>(&_ext.code);
+	bytes const& code = _ext.code;
+	uint64_t pc = (uint64_t)m_curPC;
+	Instruction inst = Instruction::STOP;
+	auto osteps = _steps;
+
+	// Fees are reckoned as in go(): in 64 bits, with wideGas() taking over once any operand is flagged as too wide.
+	bool wide = false;
+	auto narrow = [&](u256 const& _v) -> uint64_t { if (_v > c_maxFastOperand) { wide = true; return 0; } return (uint64_t)_v; };
+	auto memNeed = [&](u256 const& _offset, u256 const& _size) -> uint64_t { return _size ? narrow(_offset) + narrow(_size) : 0; };
+
+	auto charge = [&](uint64_t _runGas)
+	{
+		if (Trace)
+			_onOp(osteps - _steps - 1, inst, 0, _runGas, this, &_ext);
+		if (m_gas < _runGas)
+		{
+			// Out of gas!
+			m_gas = 0;
+			BOOST_THROW_EXCEPTION(OutOfGas());
+		}
+		m_gas -= _runGas;
+	};
+
+	auto chargeMem = [&](uint64_t _runGas, uint64_t _newTempSize, uint64_t _copySize)
+	{
+		if (wide || m_temp.size() > c_maxFastOperand)
+		{
+			wide = false;
+			bigint newTempSize;
+			bigint runGas = wideGas(inst, newTempSize);
+			if (Trace)
+				_onOp(osteps - _steps - 1, inst, newTempSize > m_temp.size() ? (newTempSize - m_temp.size()) / 32 : bigint(0), runGas, this, &_ext);
+			if (m_gas < runGas)
+			{
+				// Out of gas!
+				m_gas = 0;
+				BOOST_THROW_EXCEPTION(OutOfGas());
+			}
+			m_gas = (u256)((bigint)m_gas - runGas);
+			if (newTempSize > m_temp.size())
+				m_temp.resize((size_t)newTempSize);
+			return;
+		}
+
+		_newTempSize = (_newTempSize + 31) / 32 * 32;
+		if (_newTempSize > m_temp.size())
+			_runGas += gasForMem(_newTempSize) - gasForMem(m_temp.size());
+		_runGas += fees.copy * (_copySize + 31) / 32;
+		if (Trace)
+			_onOp(osteps - _steps - 1, inst, _newTempSize > m_temp.size() ? (_newTempSize - m_temp.size()) / 32 : 0, _runGas, this, &_ext);
+		if (m_gas < _runGas)
+		{
+			// Out of gas!
+			m_gas = 0;
+			BOOST_THROW_EXCEPTION(OutOfGas());
+		}
+		m_gas -= _runGas;
+		if (_newTempSize > m_temp.size())
+			m_temp.resize((size_t)_newTempSize);
+	};
+
+#if ETH_COMPUTED_GOTO
+	ETH_DISPATCH
+#else
+l_dispatch:
+	ETH_FETCH
+	switch ((unsigned)s_table[(byte)inst])
+	{
+#endif
+
+	ETH_CASE(BAD)
+		BOOST_THROW_EXCEPTION(BadInstruction());
+
+	ETH_CASE(STOP)
+		charge(0);
+		m_curPC = pc;
+		return bytesConstRef();
+
+	ETH_CASE(SUICIDE)
+	{
+		require(1);
+		charge(0);
+		m_curPC = pc;
+		Address dest = asAddress(m_stack.back());
+		_ext.suicide(dest);
+		return bytesConstRef();
+	}
+
+	ETH_CASE(RETURN)
+	{
+		require(2);
+		chargeMem(fees.step, memNeed(m_stack.back(), m_stack[m_stack.size() - 2]), 0);
+		m_curPC = pc;
+		unsigned b = (unsigned)m_stack.back();
+		m_stack.pop_back();
+		unsigned s = (unsigned)m_stack.back();
+		m_stack.pop_back();
+		return bytesConstRef(m_temp.data() + b, s);
+	}
+
+	ETH_CASE(ADD)
+		require(2);
+		charge(fees.step);
+		m_stack[m_stack.size() - 2] += m_stack.back();
+		m_stack.pop_back();
+		ETH_NEXT
+
+	ETH_CASE(MUL)
+		require(2);
+		charge(fees.step);
+		m_stack[m_stack.size() - 2] *= m_stack.back();
+		m_stack.pop_back();
+		ETH_NEXT
+
+	ETH_CASE(SUB)
+		require(2);
+		charge(fees.step);
+		m_stack[m_stack.size() - 2] = m_stack.back() - m_stack[m_stack.size() - 2];
+		m_stack.pop_back();
+		ETH_NEXT
+
+	ETH_CASE(DIV)
+		require(2);
+		charge(fees.step);
+		m_stack[m_stack.size() - 2] = m_stack[m_stack.size() - 2] ? m_stack.back() / m_stack[m_stack.size() - 2] : 0;
+		m_stack.pop_back();
+		ETH_NEXT
+
+	ETH_CASE(SDIV)
+		require(2);
+		charge(fees.step);
+		m_stack[m_stack.size() - 2] = m_stack[m_stack.size() - 2] ? s2u(u2s(m_stack.back()) / u2s(m_stack[m_stack.size() - 2])) : 0;
+		m_stack.pop_back();
+		ETH_NEXT
+
+	ETH_CASE(MOD)
+		require(2);
+		charge(fees.step);
+		m_stack[m_stack.size() - 2] = m_stack[m_stack.size() - 2] ? m_stack.back() % m_stack[m_stack.size() - 2] : 0;
+		m_stack.pop_back();
+		ETH_NEXT
+
+	ETH_CASE(SMOD)
+		require(2);
+		charge(fees.step);
+		m_stack[m_stack.size() - 2] = m_stack[m_stack.size() - 2] ? s2u(u2s(m_stack.back()) % u2s(m_stack[m_stack.size() - 2])) : 0;
+		m_stack.pop_back();
+		ETH_NEXT
+
+	ETH_CASE(ADDMOD)
+		require(3);
+		charge(fees.step);
+		m_stack[m_stack.size() - 3] = m_stack[m_stack.size() - 3] ? u256((bigint(m_stack.back()) + bigint(m_stack[m_stack.size() - 2])) % m_stack[m_stack.size() - 3]) : 0;
+		m_stack.pop_back();
+		m_stack.pop_back();
+		ETH_NEXT
+
+	ETH_CASE(MULMOD)
+		require(3);
+		charge(fees.step);
+		m_stack[m_stack.size() - 3] = m_stack[m_stack.size() - 3] ? u256((bigint(m_stack.back()) * bigint(m_stack[m_stack.size() - 2])) % m_stack[m_stack.size() - 3]) : 0;
+		m_stack.pop_back();
+		m_stack.pop_back();
+		ETH_NEXT
+
+	ETH_CASE(EXP)
+	{
+		require(2);
+		auto base = m_stack.back();
+		auto expon = m_stack[m_stack.size() - 2];
+		charge(fees.exp + fees.expByte * (32 - (h256(expon).firstBitSet() / 8)));
+		m_stack.pop_back();
+		m_stack.back() = (u256)boost::multiprecision::powm((bigint)base, (bigint)expon, bigint(2) << 256);
+		ETH_NEXT
+	}
+
+	ETH_CASE(SIGNEXTEND)
+		require(2);
+		charge(fees.step);
+		if (m_stack.back() < 31)
+		{
+			unsigned const testBit(m_stack.back() * 8 + 7);
+			u256& number = m_stack[m_stack.size() - 2];
+			u256 mask = ((u256(1) << testBit) - 1);
+			if (boost::multiprecision::bit_test(number, testBit))
+				number |= ~mask;
+			else
+				number &= mask;
+		}
+		m_stack.pop_back();
+		ETH_NEXT
+
+	ETH_CASE(LT)
+		require(2);
+		charge(fees.step);
+		m_stack[m_stack.size() - 2] = m_stack.back() < m_stack[m_stack.size() - 2] ? 1 : 0;
+		m_stack.pop_back();
+		ETH_NEXT
+
+	ETH_CASE(GT)
+		require(2);
+		charge(fees.step);
+		m_stack[m_stack.size() - 2] = m_stack.back() > m_stack[m_stack.size() - 2] ? 1 : 0;
+		m_stack.pop_back();
+		ETH_NEXT
+
+	ETH_CASE(SLT)
+		require(2);
+		charge(fees.step);
+		m_stack[m_stack.size() - 2] = u2s(m_stack.back()) < u2s(m_stack[m_stack.size() - 2]) ? 1 : 0;
+		m_stack.pop_back();
+		ETH_NEXT
+
+	ETH_CASE(SGT)
+		require(2);
+		charge(fees.step);
+		m_stack[m_stack.size() - 2] = u2s(m_stack.back()) > u2s(m_stack[m_stack.size() - 2]) ? 1 : 0;
+		m_stack.pop_back();
+		ETH_NEXT
+
+	ETH_CASE(EQ)
+		require(2);
+		charge(fees.step);
+		m_stack[m_stack.size() - 2] = m_stack.back() == m_stack[m_stack.size() - 2] ? 1 : 0;
+		m_stack.pop_back();
+		ETH_NEXT
+
+	ETH_CASE(ISZERO)
+		require(1);
+		charge(fees.step);
+		m_stack.back() = m_stack.back() ? 0 : 1;
+		ETH_NEXT
+
+	ETH_CASE(AND)
+		require(2);
+		charge(fees.step);
+		m_stack[m_stack.size() - 2] = m_stack.back() & m_stack[m_stack.size() - 2];
+		m_stack.pop_back();
+		ETH_NEXT
+
+	ETH_CASE(OR)
+		require(2);
+		charge(fees.step);
+		m_stack[m_stack.size() - 2] = m_stack.back() | m_stack[m_stack.size() - 2];
+		m_stack.pop_back();
+		ETH_NEXT
+
+	ETH_CASE(XOR)
+		require(2);
+		charge(fees.step);
+		m_stack[m_stack.size() - 2] = m_stack.back() ^ m_stack[m_stack.size() - 2];
+		m_stack.pop_back();
+		ETH_NEXT
+
+	ETH_CASE(NOT)
+		require(1);
+		charge(fees.step);
+		m_stack.back() = ~m_stack.back();
+		ETH_NEXT
+
+	ETH_CASE(BYTE)
+		require(2);
+		charge(fees.step);
+		m_stack[m_stack.size() - 2] = m_stack.back() < 32 ? (m_stack[m_stack.size() - 2] >> (unsigned)(8 * (31 - m_stack.back()))) & 0xff : 0;
+		m_stack.pop_back();
+		ETH_NEXT
+
+	ETH_CASE(SHA3)
+	{
+		require(2);
+		chargeMem(fees.sha3 + (narrow(m_stack[m_stack.size() - 2]) + 31) / 32 * fees.sha3Word, memNeed(m_stack.back(), m_stack[m_stack.size() - 2]), 0);
+		unsigned inOff = (unsigned)m_stack.back();
+		m_stack.pop_back();
+		unsigned inSize = (unsigned)m_stack.back();
+		m_stack.pop_back();
+		m_stack.push_back(sha3(bytesConstRef(m_temp.data() + inOff, inSize)));
+		ETH_NEXT
+	}
+
+	ETH_CASE(ADDRESS)
+		charge(fees.step);
+		m_stack.push_back(fromAddress(_ext.myAddress));
+		ETH_NEXT
+
+	ETH_CASE(ORIGIN)
+		charge(fees.step);
+		m_stack.push_back(fromAddress(_ext.origin));
+		ETH_NEXT
+
+	ETH_CASE(BALANCE)
+		require(1);
+		charge(fees.balance);
+		m_stack.back() = _ext.balance(asAddress(m_stack.back()));
+		ETH_NEXT
+
+	ETH_CASE(CALLER)
+		charge(fees.step);
+		m_stack.push_back(fromAddress(_ext.caller));
+		ETH_NEXT
+
+	ETH_CASE(CALLVALUE)
+		charge(fees.step);
+		m_stack.push_back(_ext.value);
+		ETH_NEXT
+
+	ETH_CASE(CALLDATALOAD)
+		require(1);
+		charge(fees.step);
+		if ((unsigned)m_stack.back() + (uint64_t)31 < _ext.data.size())
+			m_stack.back() = (u256)*(h256 const*)(_ext.data.data() + (unsigned)m_stack.back());
+		else
+		{
+			h256 r;
+			for (uint64_t i = (unsigned)m_stack.back(), e = (unsigned)m_stack.back() + (uint64_t)32, j = 0; i < e; ++i, ++j)
+				r[j] = i < _ext.data.size() ? _ext.data[i] : 0;
+			m_stack.back() = (u256)r;
+		}
+		ETH_NEXT
+
+	ETH_CASE(CALLDATASIZE)
+		charge(fees.step);
+		m_stack.push_back(_ext.data.size());
+		ETH_NEXT
+
+	ETH_CASE(CODESIZE)
+		charge(fees.step);
+		m_stack.push_back(_ext.code.size());
+		ETH_NEXT
+
+	ETH_CASE(EXTCODESIZE)
+		require(1);
+		charge(fees.step);
+		m_stack.back() = _ext.codeAt(asAddress(m_stack.back())).size();
+		ETH_NEXT
+
+	ETH_CASE(CALLDATACOPY)
+		require(3);
+		chargeMem(fees.step, memNeed(m_stack.back(), m_stack[m_stack.size() - 3]), narrow(m_stack[m_stack.size() - 3]));
+		copyToMemory(_ext.data);
+		ETH_NEXT
+
+	ETH_CASE(CODECOPY)
+		require(3);
+		chargeMem(fees.step, memNeed(m_stack.back(), m_stack[m_stack.size() - 3]), narrow(m_stack[m_stack.size() - 3]));
+		copyToMemory(&_ext.code);
+		ETH_NEXT
+
+	ETH_CASE(EXTCODECOPY)
+	{
+		require(4);
+		chargeMem(fees.step, memNeed(m_stack[m_stack.size() - 2], m_stack[m_stack.size() - 4]), narrow(m_stack[m_stack.size() - 4]));
+		Address a = asAddress(m_stack.back());
+		m_stack.pop_back();
+		copyToMemory(&_ext.codeAt(a));
+		ETH_NEXT
+	}
+
+	ETH_CASE(GASPRICE)
+		charge(fees.step);
+		m_stack.push_back(_ext.gasPrice);
+		ETH_NEXT
+
+	ETH_CASE(BLOCKHASH)
+		require(1);
+		charge(fees.step);
+		m_stack.back() = (u256)_ext.blockhash(m_stack.back());
+		ETH_NEXT
+
+	ETH_CASE(COINBASE)
+		charge(fees.step);
+		m_stack.push_back((u160)_ext.currentBlock.coinbaseAddress);
+		ETH_NEXT
+
+	ETH_CASE(TIMESTAMP)
+		charge(fees.step);
+		m_stack.push_back(_ext.currentBlock.timestamp);
+		ETH_NEXT
+
+	ETH_CASE(NUMBER)
+		charge(fees.step);
+		m_stack.push_back(_ext.currentBlock.number);
+		ETH_NEXT
+
+	ETH_CASE(DIFFICULTY)
+		charge(fees.step);
+		m_stack.push_back(_ext.currentBlock.difficulty);
+		ETH_NEXT
+
+	ETH_CASE(GASLIMIT)
+		charge(fees.step);
+		m_stack.push_back(1000000);
+		ETH_NEXT
+
+	ETH_CASE(PUSH)
+		charge(fees.step);
+		m_stack.push_back(m_code->pushValue(pc));
+		pc += (byte)inst - (byte)Instruction::PUSH1 + 2;
+		ETH_DISPATCH
+
+	ETH_CASE(POP)
+		require(1);
+		charge(fees.step);
+		m_stack.pop_back();
+		ETH_NEXT
+
+	ETH_CASE(DUP)
+	{
+		unsigned n = 1 + (byte)inst - (byte)Instruction::DUP1;
+		require(n);
+		charge(fees.step);
+		m_stack.push_back(m_stack[m_stack.size() - n]);
+		ETH_NEXT
+	}
+
+	ETH_CASE(SWAP)
+	{
+		unsigned n = (byte)inst - (byte)Instruction::SWAP1 + 2;
+		require(n);
+		charge(fees.step);
+		std::swap(m_stack.back(), m_stack[m_stack.size() - n]);
+		ETH_NEXT
+	}
+
+	ETH_CASE(MLOAD)
+		require(1);
+		chargeMem(fees.step, memNeed(m_stack.back(), 32), 0);
+		m_stack.back() = (u256)*(h256 const*)(m_temp.data() + (unsigned)m_stack.back());
+		ETH_NEXT
+
+	ETH_CASE(MSTORE)
+		require(2);
+		chargeMem(fees.step, memNeed(m_stack.back(), 32), 0);
+		*(h256*)&m_temp[(unsigned)m_stack.back()] = (h256)m_stack[m_stack.size() - 2];
+		m_stack.pop_back();
+		m_stack.pop_back();
+		ETH_NEXT
+
+	ETH_CASE(MSTORE8)
+		require(2);
+		chargeMem(fees.step, memNeed(m_stack.back(), 1), 0);
+		m_temp[(unsigned)m_stack.back()] = (byte)(m_stack[m_stack.size() - 2] & 0xff);
+		m_stack.pop_back();
+		m_stack.pop_back();
+		ETH_NEXT
+
+	ETH_CASE(SLOAD)
+		require(1);
+		charge(fees.sload);
+		m_stack.back() = _ext.store(m_stack.back());
+		ETH_NEXT
+
+	ETH_CASE(SSTORE)
+	{
+		require(2);
+		uint64_t runGas;
+		if (!_ext.store(m_stack.back()) && m_stack[m_stack.size() - 2])
+			runGas = fees.sstoreSet;
+		else if (_ext.store(m_stack.back()) && !m_stack[m_stack.size() - 2])
+		{
+			runGas = 0;
+			_ext.sub.refunds += c_sstoreRefundGas;
+		}
+		else
+			runGas = fees.sstoreReset;
+		charge(runGas);
+		_ext.setStore(m_stack.back(), m_stack[m_stack.size() - 2]);
+		m_stack.pop_back();
+		m_stack.pop_back();
+		ETH_NEXT
+	}
+
+	ETH_CASE(JUMP)
+		require(1);
+		charge(fees.step);
+		if (!m_code->isJumpDest(m_stack.back()))
+			BOOST_THROW_EXCEPTION(BadJumpDestination());
+		pc = (uint64_t)m_stack.back();
+		m_stack.pop_back();
+		ETH_DISPATCH
+
+	ETH_CASE(JUMPI)
+		require(2);
+		charge(fees.step);
+		if (m_stack[m_stack.size() - 2])
+		{
+			if (!m_code->isJumpDest(m_stack.back()))
+				BOOST_THROW_EXCEPTION(BadJumpDestination());
+			pc = (uint64_t)m_stack.back();
+			m_stack.pop_back();
+			m_stack.pop_back();
+			ETH_DISPATCH
+		}
+		m_stack.pop_back();
+		m_stack.pop_back();
+		ETH_NEXT
+
+	ETH_CASE(PC)
+		charge(fees.step);
+		m_stack.push_back(pc);
+		ETH_NEXT
+
+	ETH_CASE(MSIZE)
+		charge(fees.step);
+		m_stack.push_back(m_temp.size());
+		ETH_NEXT
+
+	ETH_CASE(GAS)
+		charge(fees.step);
+		m_stack.push_back(m_gas);
+		ETH_NEXT
+
+	ETH_CASE(JUMPDEST)
+		charge(fees.step);
+		ETH_NEXT
+
+	ETH_CASE(LOG)
+	{
+		unsigned n = (byte)inst - (byte)Instruction::LOG0;
+		require(n + 2);
+		chargeMem(fees.log + fees.logTopic * n + fees.logData * narrow(m_stack[m_stack.size() - 2]), memNeed(m_stack[m_stack.size() - 1], m_stack[m_stack.size() - 2]), 0);
+		h256s topics;
+		for (unsigned i = 0; i < n; ++i)
+			topics.push_back((h256)m_stack[m_stack.size() - 3 - i]);
+		_ext.log(std::move(topics), bytesConstRef(m_temp.data() + (unsigned)m_stack[m_stack.size() - 1], (unsigned)m_stack[m_stack.size() - 2]));
+		m_stack.resize(m_stack.size() - n - 2);
+		ETH_NEXT
+	}
+
+	ETH_CASE(CREATE)
+	{
+		require(3);
+		chargeMem(fees.create, memNeed(m_stack[m_stack.size() - 2], m_stack[m_stack.size() - 3]), 0);
+		u256 endowment = m_stack.back();
+		m_stack.pop_back();
+		unsigned initOff = (unsigned)m_stack.back();
+		m_stack.pop_back();
+		unsigned initSize = (unsigned)m_stack.back();
+		m_stack.pop_back();
+
+		if (_ext.balance(_ext.myAddress) >= endowment && _ext.depth < 1024)
+		{
+			_ext.subBalance(endowment);
+			m_stack.push_back((u160)_ext.create(endowment, m_gas, bytesConstRef(m_temp.data() + initOff, initSize), _onOp));
+		}
+		else
+			m_stack.push_back(0);
+		ETH_NEXT
+	}
+
+	ETH_CASE(CALL)
+	{
+		require(7);
+		chargeMem(fees.call + narrow(m_stack[m_stack.size() - 1]), std::max(memNeed(m_stack[m_stack.size() - 6], m_stack[m_stack.size() - 7]), memNeed(m_stack[m_stack.size() - 4], m_stack[m_stack.size() - 5])), 0);
+		u256 gas = m_stack.back();
+		m_stack.pop_back();
+		Address receiveAddress = asAddress(m_stack.back());
+		m_stack.pop_back();
+		u256 value = m_stack.back();
+		m_stack.pop_back();
+
+		unsigned inOff = (unsigned)m_stack.back();
+		m_stack.pop_back();
+		unsigned inSize = (unsigned)m_stack.back();
+		m_stack.pop_back();
+		unsigned outOff = (unsigned)m_stack.back();
+		m_stack.pop_back();
+		unsigned outSize = (unsigned)m_stack.back();
+		m_stack.pop_back();
+
+		if (_ext.balance(_ext.myAddress) >= value && _ext.depth < 1024)
+		{
+			_ext.subBalance(value);
+			m_stack.push_back(_ext.call(inst == Instruction::CALL ? receiveAddress : _ext.myAddress, value, bytesConstRef(m_temp.data() + inOff, inSize), gas, bytesRef(m_temp.data() + outOff, outSize), _onOp, {}, receiveAddress));
+		}
+		else
+			m_stack.push_back(0);
+
+		m_gas += gas;
+		ETH_NEXT
+	}
+
+#if !ETH_COMPUTED_GOTO
+	}
+	return bytesConstRef();
+#endif
+}
+
+#undef ETH_NEXT
+#undef ETH_DISPATCH
+#undef ETH_CASE
+#undef ETH_FETCH
+#undef ETH_COMPUTED_GOTO
@@ -28,6 +28,7 @@
 #include <libdevcrypto/SHA3.h>
 #include <libethcore/BlockInfo.h>
 #include "FeeStructure.h"
+#include "CodeAnalysis.h"
 #include "VMFace.h"
 
 namespace dev
@@ -56,7 +57,7 @@ public:
 
 	virtual bytesConstRef go(ExtVMFace& _ext, OnOpFunc const& _onOp = {}, uint64_t _steps = (uint64_t)-1) override final;
 
-	void require(u256 _n) { if (m_stack.size() < _n) { if (m_onFail) m_onFail(); BOOST_THROW_EXCEPTION(StackTooSmall() << RequirementError((bigint)_n, (bigint)m_stack.size())); } }
+	void require(unsigned _n) { if (m_stack.size() < _n) { if (m_onFail) m_onFail(); BOOST_THROW_EXCEPTION(StackTooSmall() << RequirementError((bigint)_n, (bigint)m_stack.size())); } }
 	void requireMem(unsigned _n) { if (m_temp.size() < _n) { m_temp.resize(_n); } }
 
 	u256 curPC() const { return m_curPC; }
@@ -67,13 +68,29 @@ public:
 private:
 	friend class VMFactory;
 
-	/// Construct VM object.
-	explicit VM(u256 _gas): VMFace(_gas) {}
+	/// Construct VM object. If @a _threaded, go() runs the threaded interpreter (see goThreaded()) rather than the switch-based one.
+	explicit VM(u256 _gas, bool _threaded = false): VMFace(_gas), m_threaded(_threaded) { m_stack.reserve(c_reservedStack); }
 
+	/// Threaded interpreter: handlers are dispatched through a per-opcode table (by computed goto where the compiler
+	/// supports it) and charge their own fees. With Trace false, no tracing code is compiled in at all.
+	template <bool Trace> bytesConstRef goThreaded(ExtVMFace& _ext, OnOpFunc const& _onOp, uint64_t _steps);
+
+	/// Pops the memory offset, data index and size of a *COPY instruction and copies that slice of @a _data, zero-padded, into memory.
+	void copyToMemory(bytesConstRef _data);
+
+	/// Exact fee (and new memory size) of an instruction whose operands are too wide for the 64-bit reckoning in go().
+	bigint wideGas(Instruction _inst, bigint& o_newTempSize) const;
+
+	/// Stack slots allocated up front; deeper stacks are legal but will reallocate.
+	static const unsigned c_reservedStack = 1024;
+	/// Largest memory buffer kept across reset(); anything bigger is freed.
+	static const unsigned c_retainedMemory = 64 * 1024;
+
+	bool m_threaded = false;
 	u256 m_curPC = 0;
 	bytes m_temp;
 	u256s m_stack;
-	std::set<u256> m_jumpDests;
+	std::shared_ptr<CodeAnalysis const> m_code;	///< Analysis of the code being run; set up on the first go().
 	std::function<void()> m_onFail;
 };
 
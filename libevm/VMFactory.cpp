@@ -16,6 +16,7 @@
 */
 
 #include "VMFactory.h"
+#include <boost/thread/tss.hpp>
 #include "VM.h"
 
 #if ETH_EVMJIT
@@ -29,6 +30,19 @@ namespace eth
 namespace
 {
 	VMKind g_kind = VMKind::Interpreter;
+
+	/// Spare interpreter VMs of this thread. Nested calls each take one, so the pool needs only be as deep as
+	/// the call chains commonly seen; VMs handed back beyond that are freed.
+	using VMPool = std::vector<std::unique_ptr<VMFace>>;
+	boost::thread_specific_ptr<VMPool> t_pool;
+	unsigned const c_maxPooledVMs = 64;
+
+	VMPool& pool()
+	{
+		if (!t_pool.get())
+			t_pool.reset(new VMPool);
+		return *t_pool;
+	}
 }
 
 void VMFactory::setKind(VMKind _kind)
@@ -38,13 +52,39 @@ void VMFactory::setKind(VMKind _kind)
 
 std::unique_ptr<VMFace> VMFactory::create(u256 _gas)
 {
+	auto& p = pool();
+	while (!p.empty())
+	{
+		std::unique_ptr<VMFace> ret = std::move(p.back());
+		p.pop_back();
+		// The kind may have changed since the VM was pooled.
+		if (g_kind != VMKind::JIT && static_cast<VM&>(*ret).m_threaded == (g_kind == VMKind::Threaded))
+		{
+			ret->reset(_gas);
+			return ret;
+		}
+	}
+
 #if ETH_EVMJIT
-	return std::unique_ptr<VMFace>(g_kind == VMKind::JIT ? (VMFace*)new JitVM(_gas) : new VM(_gas));
+	return std::unique_ptr<VMFace>(g_kind == VMKind::JIT ? (VMFace*)new JitVM(_gas) : new VM(_gas, g_kind == VMKind::Threaded));
 #else
-	asserts(g_kind == VMKind::Interpreter && "JIT disabled in build configuration");
-	return std::unique_ptr<VMFace>(new VM(_gas));
+	asserts(g_kind != VMKind::JIT && "JIT disabled in build configuration");
+	return std::unique_ptr<VMFace>(new VM(_gas, g_kind == VMKind::Threaded));
 #endif
 }
 
+void VMFactory::recycle(std::unique_ptr<VMFace>&& _vm)
+{
+	// Only interpreter VMs are pooled. Each is reset on the way in, so that while it waits it holds neither the code
+	// and callback of its last run nor more than a modest memory buffer.
+	auto& p = pool();
+	if (_vm && p.size() < c_maxPooledVMs && dynamic_cast<VM*>(_vm.get()))
+	{
+		_vm->reset();
+		p.push_back(std::move(_vm));
+	}
+	_vm.reset();
+}
+
 }
 }
@@ -23,9 +23,10 @@ namespace dev
 namespace eth
 {
 
-enum class VMKind: bool
+enum class VMKind
 {
 	Interpreter,
+	Threaded,
 	JIT
 };
 
@@ -34,7 +35,11 @@ class VMFactory
 public:
 	VMFactory() = delete;
 
+	/// @returns a VM of the current kind with @a _gas, reusing one from this thread's pool (see recycle()) if there is one.
 	static std::unique_ptr<VMFace> create(u256 _gas);
+	/// Hand back @a _vm, finished with, to this thread's pool; a later create() may then reuse it, together with
+	/// its already-allocated stack and memory, rather than allocating afresh.
+	static void recycle(std::unique_ptr<VMFace>&& _vm);
 	static void setKind(VMKind _kind);
 };
 
@@ -53,6 +53,16 @@ void Capability::sealAndSend(RLPStream& _s)
 	m_session->sealAndSend(_s);
 }
 
+shared_ptr<bytes const> Capability::seal(RLPStream& _s)
+{
+	return m_session->seal(_s);
+}
+
+void Capability::send(shared_ptr<bytes const> const& _msg)
+{
+	m_session->send(_msg);
+}
+
 void Capability::send(bytesConstRef _msg)
 {
 	m_session->send(_msg);
@@ -52,8 +52,13 @@ protected:
 
 	RLPStream& prep(RLPStream& _s, unsigned _id, unsigned _args = 0);
 	void sealAndSend(RLPStream& _s);
+	std::shared_ptr<bytes const> seal(RLPStream& _s);
 	void send(bytes&& _msg);
 	void send(bytesConstRef _msg);
+	void send(std::shared_ptr<bytes const> const& _msg);
+
+	/// @returns the offset of our packet ids for this peer. Packets prepared for peers with the same offset are alike.
+	unsigned idOffset() const { return m_idOffset; }
 
 	void addRating(unsigned _r);
 
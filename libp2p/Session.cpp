@@ -409,6 +409,14 @@ void Session::sealAndSend(RLPStream& _s)
 	send(move(b));
 }
 
+shared_ptr<bytes const> Session::seal(RLPStream& _s)
+{
+	bytes b;
+	_s.swapOut(b);
+	m_server->seal(b);
+	return make_shared<bytes const>(move(b));
+}
+
 bool Session::checkPacket(bytesConstRef _msg)
 {
 	if (_msg.size() < 8)
@@ -431,9 +439,14 @@ void Session::send(bytesConstRef _msg)
 
 void Session::send(bytes&& _msg)
 {
-	clogS(NetLeft) << RLP(bytesConstRef(&_msg).cropped(8));
+	send(make_shared<bytes const>(move(_msg)));
+}
+
+void Session::send(shared_ptr<bytes const> const& _msg)
+{
+	clogS(NetLeft) << RLP(bytesConstRef(_msg.get()).cropped(8));
 
-	if (!checkPacket(bytesConstRef(&_msg)))
+	if (!checkPacket(bytesConstRef(_msg.get())))
 		clogS(NetWarn) << "INVALID PACKET CONSTRUCTED!";
 
 //	cerr << (void*)this << " writeImpl" << endl;
@@ -444,7 +457,9 @@ void Session::send(bytes&& _msg)
 	{
 		Guard l(x_writeQueue);
 		m_writeQueue.push_back(_msg);
-		doWrite = (m_writeQueue.size() == 1);
+		m_bytesQueued += _msg->size();
+		doWrite = !m_isWriting;
+		m_isWriting = true;
 	}
 
 	if (doWrite)
@@ -453,9 +468,19 @@ void Session::send(bytes&& _msg)
 
 void Session::write()
 {
-	const bytes& bytes = m_writeQueue[0];
+	// Gather everything queued into a single write.
+	vector<ba::const_buffer> buffers;
+	{
+		Guard l(x_writeQueue);
+		m_writing.assign(m_writeQueue.begin(), m_writeQueue.end());
+		m_writeQueue.clear();
+	}
+	buffers.reserve(m_writing.size());
+	for (auto const& i: m_writing)
+		buffers.push_back(ba::buffer(*i));
+
 	auto self(shared_from_this());
-	ba::async_write(m_socket, ba::buffer(bytes), [this, self](boost::system::error_code ec, std::size_t /*length*/)
+	ba::async_write(m_socket, buffers, [this, self](boost::system::error_code ec, std::size_t /*length*/)
 	{
 		// must check queue, as write callback can occur following dropped()
 		if (ec)
@@ -467,9 +492,14 @@ void Session::write()
 		else
 		{
 			Guard l(x_writeQueue);
-			m_writeQueue.pop_front();
+			for (auto const& i: m_writing)
+				m_bytesQueued -= i->size();
+			m_writing.clear();
 			if (m_writeQueue.empty())
+			{
+				m_isWriting = false;
 				return;
+			}
 		}
 		write();
 	});
@@ -534,78 +564,93 @@ void Session::doRead()
 	// ignore packets received while waiting to disconnect
 	if (m_dropped)
 		return;
-	
+
+	// Read just the header first, so that the payload can then be read straight into place in one go.
 	auto self(shared_from_this());
-	m_socket.async_read_some(boost::asio::buffer(m_data), [this,self](boost::system::error_code ec, std::size_t length)
+	m_incoming.resize(8);
+	boost::asio::async_read(m_socket, boost::asio::buffer(m_incoming.data(), 8), [this,self](boost::system::error_code ec, std::size_t)
 	{
-		// If error is end of file, ignore
-		if (ec && ec.category() != boost::asio::error::get_misc_category() && ec.value() != boost::asio::error::eof)
+		if (!checkRead(ec))
+			return;
+
+		if (m_incoming[0] != 0x22 || m_incoming[1] != 0x40 || m_incoming[2] != 0x08 || m_incoming[3] != 0x91)
 		{
-			// got here with length of 1241...
-			clogS(NetWarn) << "Error reading: " << ec.message();
-			drop(TCPError);
+			clogS(NetWarn) << "INVALID SYNCHRONISATION TOKEN; expected = 22400891; received = " << toHex(bytesConstRef(m_incoming.data(), 4));
+			disconnect(BadProtocol);
+			return;
 		}
-		else if (ec && length == 0)
+
+		uint32_t len = fromBigEndian<uint32_t>(bytesConstRef(m_incoming.data() + 4, 4));
+		if (len > c_maxPayload)
 		{
+			clogS(NetWarn) << "PACKET TOO LARGE; length =" << len;
+			disconnect(BadProtocol);
 			return;
 		}
-		else
+		doReadPayload(len);
+	});
+}
+
+void Session::doReadPayload(uint32_t _len)
+{
+	if (m_dropped)
+		return;
+
+	auto self(shared_from_this());
+	m_incoming.resize(8 + _len);
+	boost::asio::async_read(m_socket, boost::asio::buffer(m_incoming.data() + 8, _len), [this,self](boost::system::error_code ec, std::size_t)
+	{
+		if (!checkRead(ec))
+			return;
+
+		try
 		{
-			try
-			{
-				m_incoming.resize(m_incoming.size() + length);
-				memcpy(m_incoming.data() + m_incoming.size() - length, m_data.data(), length);
-				while (m_incoming.size() > 8)
-				{
-					if (m_incoming[0] != 0x22 || m_incoming[1] != 0x40 || m_incoming[2] != 0x08 || m_incoming[3] != 0x91)
-					{
-						clogS(NetWarn) << "INVALID SYNCHRONISATION TOKEN; expected = 22400891; received = " << toHex(bytesConstRef(m_incoming.data(), 4));
-						disconnect(BadProtocol);
-						return;
-					}
-					else
-					{
-						uint32_t len = fromBigEndian<uint32_t>(bytesConstRef(m_incoming.data() + 4, 4));
-						uint32_t tlen = len + 8;
-						if (m_incoming.size() < tlen)
-							break;
-
-						// enough has come in.
-						auto data = bytesConstRef(m_incoming.data(), tlen);
-						if (!checkPacket(data))
-						{
-							cerr << "Received " << len << ": " << toHex(bytesConstRef(m_incoming.data() + 8, len)) << endl;
-							clogS(NetWarn) << "INVALID MESSAGE RECEIVED";
-							disconnect(BadProtocol);
-							return;
-						}
-						else
-						{
-							RLP r(data.cropped(8));
-							if (!interpret(r))
-							{
-								// error - bad protocol
-								clogS(NetWarn) << "Couldn't interpret packet." << RLP(r);
-								// Just wasting our bandwidth - perhaps reduce rating?
-								//return;
-							}
-						}
-						memmove(m_incoming.data(), m_incoming.data() + tlen, m_incoming.size() - tlen);
-						m_incoming.resize(m_incoming.size() - tlen);
-					}
-				}
-				doRead();
-			}
-			catch (Exception const& _e)
+			auto data = bytesConstRef(&m_incoming);
+			if (!checkPacket(data))
 			{
-				clogS(NetWarn) << "ERROR: " << diagnostic_information(_e);
-				drop(BadProtocol);
+				cerr << "Received " << data.size() - 8 << ": " << toHex(data.cropped(8)) << endl;
+				clogS(NetWarn) << "INVALID MESSAGE RECEIVED";
+				disconnect(BadProtocol);
+				return;
 			}
-			catch (std::exception const& _e)
+			else
 			{
-				clogS(NetWarn) << "ERROR: " << _e.what();
-				drop(BadProtocol);
+				RLP r(data.cropped(8));
+				if (!interpret(r))
+				{
+					// error - bad protocol
+					clogS(NetWarn) << "Couldn't interpret packet." << RLP(r);
+					// Just wasting our bandwidth - perhaps reduce rating?
+					//return;
+				}
 			}
+
+			// Don't keep hold of the buffer of the odd huge packet.
+			if (m_incoming.capacity() > c_retainedIncoming)
+				bytes().swap(m_incoming);
+			doRead();
+		}
+		catch (Exception const& _e)
+		{
+			clogS(NetWarn) << "ERROR: " << diagnostic_information(_e);
+			drop(BadProtocol);
+		}
+		catch (std::exception const& _e)
+		{
+			clogS(NetWarn) << "ERROR: " << _e.what();
+			drop(BadProtocol);
 		}
 	});
 }
+
+bool Session::checkRead(boost::system::error_code _ec)
+{
+	// If error is end of file, ignore
+	if (_ec && _ec.category() != boost::asio::error::get_misc_category() && _ec.value() != boost::asio::error::eof)
+	{
+		clogS(NetWarn) << "Error reading: " << _ec.message();
+		drop(TCPError);
+	}
+	// An exact read that went wrong came up short, so there's nothing to interpret.
+	return !_ec;
+}
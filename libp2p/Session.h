@@ -73,8 +73,19 @@ public:
 	static RLPStream& prep(RLPStream& _s, PacketType _t, unsigned _args = 0);
 	static RLPStream& prep(RLPStream& _s);
 	void sealAndSend(RLPStream& _s);
+	/// @returns the packet in @a _s sealed, ready to be sent to any number of peers with send().
+	std::shared_ptr<bytes const> seal(RLPStream& _s);
 	void send(bytes&& _msg);
 	void send(bytesConstRef _msg);
+	/// Queue the sealed packet @a _msg; it is shared rather than copied, so the same one may go to many peers.
+	void send(std::shared_ptr<bytes const> const& _msg);
+
+	/// @returns the number of packets queued or being written.
+	size_t writeQueueDepth() const { Guard l(x_writeQueue); return m_writeQueue.size() + m_writing.size(); }
+	/// @returns the number of bytes queued or being written.
+	size_t bytesQueued() const { Guard l(x_writeQueue); return m_bytesQueued; }
+	/// @returns true if the peer is so far behind in taking what we send that anything optional is better not sent.
+	bool isBackedUp() const { return bytesQueued() > c_maxBytesQueued; }
 
 	int rating() const;
 	void addRating(unsigned _r);
@@ -90,10 +101,16 @@ private:
 	/// Drop the connection for the reason @a _r.
 	void drop(DisconnectReason _r);
 
-	/// Perform a read on the socket.
+	/// Read the header of the next packet from the socket, then its payload with doReadPayload().
 	void doRead();
 
-	/// Perform a single round of the write operation. This could end up calling itself asynchronously.
+	/// Read the @a _len bytes of payload following the header already in m_incoming, then interpret the packet.
+	void doReadPayload(uint32_t _len);
+
+	/// @returns true if a read that completed with @a _ec went well; otherwise drops the connection on error.
+	bool checkRead(boost::system::error_code _ec);
+
+	/// Write everything queued in one go. This could end up calling itself asynchronously.
 	void write();
 
 	/// Interpret an incoming message.
@@ -105,10 +122,16 @@ private:
 	Host* m_server;							///< The host that owns us. Never null.
 
 	mutable bi::tcp::socket m_socket;		///< Socket for the peer's connection. Mutable to ask for native_handle().
-	Mutex x_writeQueue;						///< Mutex for the write queue.
-	std::deque<bytes> m_writeQueue;			///< The write queue.
-	std::array<byte, 65536> m_data;			///< Buffer for ingress packet data.
-	bytes m_incoming;						///< Read buffer for ingress bytes.
+	mutable Mutex x_writeQueue;				///< Mutex for the write queue.
+	std::deque<std::shared_ptr<bytes const>> m_writeQueue;	///< The write queue: packets waiting for the current write, if any, to finish.
+	std::vector<std::shared_ptr<bytes const>> m_writing;	///< The packets of the current write, gathered from the write queue.
+	size_t m_bytesQueued = 0;				///< The total size of the packets in the write queue and the current write.
+	bool m_isWriting = false;				///< True while a write is under way.
+	bytes m_incoming;						///< The ingress packet being read, header and all; its buffer is reused from one packet to the next.
+
+	static const uint32_t c_maxPayload = 16 * 1024 * 1024;		///< Largest packet payload we'll accept.
+	static const size_t c_maxBytesQueued = 4 * 1024 * 1024;		///< Bytes queued beyond which the peer is backed up; see isBackedUp().
+	static const unsigned c_retainedIncoming = 1024 * 1024;	///< Largest m_incoming buffer kept for the next packet.
 
 	PeerInfo m_info;						///< Dynamic information about this peer.
 
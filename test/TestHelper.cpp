@@ -114,11 +114,12 @@ void ImportTest::importState(json_spirit::mObject& _o, State& _state)
 
 		if (code.size())
 		{
-			_state.m_cache[address] = Account(toInt(o["balance"]), Account::ContractConception);
-			_state.m_cache[address].setCode(code);
+			Account& a = _state.changeAccount(address);
+			a = Account(toInt(o["balance"]), Account::ContractConception);
+			a.setCode(code);
 		}
 		else
-			_state.m_cache[address] = Account(toInt(o["balance"]), Account::NormalCreation);
+			_state.changeAccount(address) = Account(toInt(o["balance"]), Account::NormalCreation);
 
 		for (auto const& j: o["storage"].get_obj())
 			_state.setStorage(address, toInt(j.first), toInt(j.second));
@@ -499,6 +500,11 @@ void processCommandLineOptions()
 			eth::VMFactory::setKind(eth::VMKind::JIT);
 			break;
 		}
+		else if (std::string(argv[i]) == "--threaded-vm")
+		{
+			eth::VMFactory::setKind(eth::VMKind::Threaded);
+			break;
+		}
 	}
 }
 
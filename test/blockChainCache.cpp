@@ -0,0 +1,90 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file blockChainCache.cpp
+ * @date 2015
+ * Checks that the BlockChain caches evict what's gone unused first, and account for it.
+ */
+
+#include <boost/test/unit_test.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <libethereum/BlockChain.h>
+#include <libethereum/State.h>
+#include "TestHelper.h"
+using namespace std;
+using namespace dev;
+using namespace dev::eth;
+
+BOOST_AUTO_TEST_SUITE(BlockChainCacheTests)
+
+BOOST_AUTO_TEST_CASE(generationalEviction)
+{
+	string path = (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path()).string();
+	OverlayDB db = State::openDB(path, true);
+	BlockChain bc(path, true);
+
+	KeyPair miner = sha3("cache miner");
+	State s(miner.address(), db);
+	h256s mined;
+	for (unsigned i = 0; i < 8; ++i)
+	{
+		s.sync(bc);
+		s.commitToMine(bc);
+		while (!s.mine(100, true).completed) {}
+		s.completeMine();
+		BOOST_REQUIRE(!bc.attemptImport(s.blockData(), db).empty());
+		mined.push_back(bc.currentHash());
+	}
+	h256 hot = mined.back();
+	h256 cold = mined.front();
+
+	// With room for everything, a collection evicts nothing.
+	bc.setCacheLimits(0, (size_t)-1);
+	bc.garbageCollect(true);
+	auto full = bc.cacheStats();
+	BOOST_CHECK_EQUAL(full.details.evictions, 0);
+	BOOST_REQUIRE(full.details.entries >= mined.size());
+	BOOST_REQUIRE(full.bytes() > 0);
+
+	// Over the minimum, those left unused for long enough go; those used each time stay.
+	for (unsigned i = 0; i < 16; ++i)
+	{
+		bc.details(hot);
+		bc.block(hot);
+		bc.garbageCollect(true);
+	}
+	auto aged = bc.cacheStats();
+	BOOST_CHECK(aged.details.evictions > 0);
+	BOOST_CHECK(aged.blocks.evictions > 0);
+	BOOST_CHECK(aged.details.entries < full.details.entries);
+	BOOST_CHECK(aged.bytes() < full.bytes());
+
+	bc.details(hot);
+	BOOST_CHECK_EQUAL(bc.cacheStats().details.hits, aged.details.hits + 1);
+	BOOST_CHECK_EQUAL(bc.cacheStats().details.misses, aged.details.misses);
+	bc.details(cold);
+	BOOST_CHECK_EQUAL(bc.cacheStats().details.misses, aged.details.misses + 1);
+
+	// Over the maximum, everything goes, however recently used.
+	bc.setCacheLimits(0, 0);
+	bc.garbageCollect(true);
+	auto emptied = bc.cacheStats();
+	BOOST_CHECK(emptied.bytes() < aged.bytes());
+	bc.details(hot);
+	BOOST_CHECK_EQUAL(bc.cacheStats().details.misses, emptied.details.misses + 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
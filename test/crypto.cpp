@@ -21,10 +21,12 @@
  */
 
 #include <random>
+#include <chrono>
 #include <secp256k1/secp256k1.h>
 #include <libdevcore/Common.h>
 #include <libdevcore/RLP.h>
 #include <libdevcore/Log.h>
+#include <libdevcore/ThreadPool.h>
 #include <libethereum/Transaction.h>
 #include <boost/test/unit_test.hpp>
 #include <libdevcrypto/SHA3.h>
@@ -228,6 +230,48 @@ BOOST_AUTO_TEST_CASE(cryptopp_ecdsa_sipaseckp256k1)
 	}
 }
 
+BOOST_AUTO_TEST_CASE(ecdsa_recover_backends)
+{
+	// Compares the CryptoPP and libsecp256k1 recovery paths (and dev::recover, whichever it uses, over all cores).
+	secp256k1_start();
+
+	unsigned const count = 200;
+	vector<KeyPair> keys;
+	h256s hashes;
+	vector<Signature> sigs;
+	for (unsigned i = 0; i < count; ++i)
+	{
+		keys.push_back(KeyPair(sha3(toBigEndian(u256(i + 1)))));
+		hashes.push_back(sha3(toBigEndian(u256(i))));
+		sigs.push_back(dev::sign(keys.back().sec(), hashes.back()));
+		BOOST_REQUIRE(dev::verify(keys.back().pub(), sigs.back(), hashes.back()));
+	}
+
+	auto measure = [&](string const& _name, std::function<Public(unsigned)> const& _recover)
+	{
+		auto start = chrono::steady_clock::now();
+		for (unsigned i = 0; i < count; ++i)
+			BOOST_REQUIRE(_recover(i) == keys[i].pub());
+		cnote << _name << chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count() / count << "us per recovery";
+	};
+
+	measure("CryptoPP:", [&](unsigned i) { return s_secp256k1.recover(sigs[i], hashes[i].ref()); });
+	measure("libsecp256k1:", [&](unsigned i)
+	{
+		byte pubkey[65];
+		int pubkeylen = 65;
+		BOOST_REQUIRE(secp256k1_ecdsa_recover_compact(hashes[i].data(), 32, sigs[i].data(), pubkey, &pubkeylen, 0, sigs[i][64]));
+		return Public(&pubkey[1], Public::ConstructFromPointer);
+	});
+
+	vector<Public> recovered(count);
+	auto start = chrono::steady_clock::now();
+	ThreadPool::get().forEach(count, [&](size_t i) { recovered[i] = dev::recover(sigs[i], hashes[i]); });
+	cnote << "dev::recover on" << ThreadPool::get().size() << "threads:" << chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count() / count << "us per recovery";
+	for (unsigned i = 0; i < count; ++i)
+		BOOST_REQUIRE(recovered[i] == keys[i].pub());
+}
+
 BOOST_AUTO_TEST_CASE(ecies_eckeypair)
 {
 	KeyPair k = KeyPair::create();
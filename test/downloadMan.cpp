@@ -0,0 +1,139 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file downloadMan.cpp
+ * @date 2015
+ * Checks how DownloadSub sizes its fetches and gives up overdue ones.
+ */
+
+#include <boost/test/unit_test.hpp>
+#include <libdevcrypto/SHA3.h>
+#include <libethereum/DownloadMan.h>
+using namespace std;
+using namespace dev;
+using namespace dev::eth;
+
+namespace
+{
+
+/// A chain of @a _n made-up hashes, newest first as the syncer hands them over.
+h256s chainOf(unsigned _n)
+{
+	h256s ret;
+	for (unsigned i = _n; i > 0; --i)
+		ret.push_back(sha3(h256(u256(i)).ref()));
+	return ret;
+}
+
+unsigned countOf(RangeMask<unsigned> const& _m)
+{
+	unsigned ret = 0;
+	for (auto i: _m)
+	{
+		(void)i;
+		++ret;
+	}
+	return ret;
+}
+
+/// @returns the index in @a _man's chain of @a _h.
+unsigned indexOf(DownloadMan const& _man, h256 _h)
+{
+	auto c = _man.chain();
+	return find(c.begin(), c.end(), _h) - c.begin();
+}
+
+bool overlap(h256Set const& _a, h256Set const& _b)
+{
+	for (auto const& h: _a)
+		if (_b.count(h))
+			return true;
+	return false;
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(DownloadManTests)
+
+BOOST_AUTO_TEST_CASE(fetchSizing)
+{
+	DownloadMan man;
+	DownloadSub sub(man);
+	man.resetToChain(chainOf(100));
+
+	// Unmeasured, we ask for a quarter.
+	auto first = sub.nextFetch(64);
+	BOOST_REQUIRE_EQUAL(first.size(), 16);
+	// Asking again before it's delivered just gives the same fetch.
+	BOOST_CHECK(sub.nextFetch(64) == first);
+
+	for (auto const& h: first)
+		BOOST_CHECK(sub.noteBlock(h));
+	BOOST_CHECK(!sub.noteBlock(*first.begin()));
+	BOOST_CHECK_EQUAL(countOf(man.blocksGot()), 16);
+
+	// Having delivered them all at once, we're good for as many as we're allowed.
+	auto second = sub.nextFetch(64);
+	BOOST_CHECK_EQUAL(second.size(), 64);
+	BOOST_CHECK(!overlap(first, second));
+	for (auto const& h: second)
+		sub.noteBlock(h);
+
+	// Only what's left.
+	BOOST_CHECK_EQUAL(sub.nextFetch(64).size(), 20);
+}
+
+BOOST_AUTO_TEST_CASE(overdueRelease)
+{
+	DownloadMan man;
+	DownloadSub slow(man);
+	DownloadSub other(man);
+	man.resetToChain(chainOf(100));
+
+	auto now = chrono::steady_clock::now();
+	auto asked = slow.nextFetch(64);
+	BOOST_REQUIRE_EQUAL(asked.size(), 16);
+	BOOST_CHECK(!slow.isOverdue(now));
+	BOOST_CHECK(!slow.isOverdue(now + chrono::seconds(5)));
+	BOOST_CHECK(slow.isOverdue(now + chrono::seconds(11)));
+
+	// While it's held, others are given different blocks.
+	auto took = other.nextFetch(8);
+	BOOST_REQUIRE_EQUAL(took.size(), 2);
+	BOOST_CHECK(!overlap(asked, took));
+	for (auto const& h: took)
+		other.noteBlock(h);
+
+	// Once released, it's no longer overdue and its blocks are free for the others to take.
+	slow.releaseFetch();
+	BOOST_CHECK(!slow.isOverdue(now + chrono::seconds(11)));
+	auto retaken = other.nextFetch(64);
+	BOOST_REQUIRE_EQUAL(retaken.size(), 64);
+	for (auto const& h: asked)
+		BOOST_CHECK(retaken.count(h));
+
+	// A straggler is still taken.
+	BOOST_CHECK(slow.noteBlock(*asked.begin()));
+	BOOST_CHECK(man.blocksGot().contains(indexOf(man, *asked.begin())));
+
+	// Having delivered nothing in time, the next fetch is fresh and as small as we go.
+	auto next = slow.nextFetch(64);
+	BOOST_CHECK_EQUAL(next.size(), 4);
+	BOOST_CHECK(!overlap(next, retaken));
+	BOOST_CHECK(!next.count(*asked.begin()));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -21,7 +21,7 @@
  */
 
 #include <libdevcrypto/TrieDB.h>
-#include "TrieHash.h"
+#include <libdevcrypto/TrieHash.h>
 #include "MemTrie.h"
 
 #include <boost/test/unit_test.hpp>
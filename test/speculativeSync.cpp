@@ -0,0 +1,144 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file speculativeSync.cpp
+ * @date 2015
+ * Checks that State::sync builds the same block whether or not it speculates.
+ */
+
+#include <boost/test/unit_test.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <libethereum/BlockChain.h>
+#include <libethereum/State.h>
+#include <libethereum/TransactionQueue.h>
+#include "TestHelper.h"
+using namespace std;
+using namespace dev;
+using namespace dev::eth;
+
+namespace
+{
+
+/// Runtime: adds calldata[0] to storage location 0.
+bytes const c_accumulate = fromHex("600035" "600054" "01" "600055");
+/// Init: returns the 10 bytes of runtime that follow it.
+bytes const c_accumulateInit = fromHex("600a80600b6000396000f3") + c_accumulate;
+
+/// Sync @a _s from @a _tq, speculating if @a _speculative, and @returns the receipts.
+TransactionReceipts syncFrom(State& _s, BlockChain const& _bc, TransactionQueue& _tq, bool _speculative)
+{
+	State::setSpeculative(_speculative);
+	auto ret = _s.sync(_bc, _tq);
+	State::setSpeculative(false);
+	return ret;
+}
+
+/// Require that @a _a & @a _b built the same block with the same receipts, and left their queues alike.
+void checkSame(State const& _a, TransactionReceipts const& _ar, TransactionQueue const& _aq, State const& _b, TransactionReceipts const& _br, TransactionQueue const& _bq)
+{
+	BOOST_REQUIRE_EQUAL(_a.rootHash(), _b.rootHash());
+
+	BOOST_REQUIRE_EQUAL(_ar.size(), _br.size());
+	for (unsigned i = 0; i < _ar.size(); ++i)
+		BOOST_CHECK(_ar[i].rlp() == _br[i].rlp());
+
+	BOOST_REQUIRE_EQUAL(_a.pending().size(), _b.pending().size());
+	for (unsigned i = 0; i < _a.pending().size(); ++i)
+	{
+		BOOST_CHECK(_a.pending()[i].rlp() == _b.pending()[i].rlp());
+		BOOST_CHECK(_a.receipt(i).rlp() == _b.receipt(i).rlp());
+	}
+
+	// Those dropped have gone from both; those with future nonces are held back by both.
+	BOOST_CHECK(_aq.items() == _bq.items());
+	auto at = _aq.transactions();
+	auto bt = _bq.transactions();
+	BOOST_REQUIRE_EQUAL(at.size(), bt.size());
+	for (auto ai = at.begin(), bi = bt.begin(); ai != at.end(); ++ai, ++bi)
+		BOOST_CHECK_EQUAL(ai->first, bi->first);
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(SpeculativeSyncTests)
+
+BOOST_AUTO_TEST_CASE(speculativeMatchesSerial)
+{
+	KeyPair a = sha3("speculative sender A");
+	KeyPair b = sha3("speculative sender B");	// Has nothing until A pays it.
+	KeyPair c = sha3("speculative sender C");
+	KeyPair d = sha3("speculative sender D");
+	Address e = right160(sha3("speculative recipient"));
+	Address coinbase = right160(sha3("speculative coinbase"));
+	Address accumulator = right160(sha3(rlpList(a.address(), u256(0))));
+
+	BlockChain bc((boost::filesystem::temp_directory_path() / boost::filesystem::unique_path()).string(), true);
+
+	State base(coinbase, OverlayDB(), BaseState::Genesis);
+	for (auto const& k: { a, c, d })
+		base.addBalance(k.address(), 10 * ether);
+	base.commit();
+
+	State serial(base);
+	State speculative(base);
+	TransactionQueue serialQ;
+	TransactionQueue speculativeQ;
+
+	u256 const gasPrice = 10 * szabo;
+	auto send = [&](KeyPair const& _from, Address const& _to, u256 _value, bytes const& _data, u256 _nonce, u256 _gas = 10000)
+	{
+		bytes tx = Transaction(_value, gasPrice, _gas, _to, _data, _nonce, _from.secret()).rlp();
+		serialQ.attemptImport(tx);
+		speculativeQ.attemptImport(tx);
+	};
+	auto sync = [&]()
+	{
+		auto sr = syncFrom(serial, bc, serialQ, false);
+		auto pr = syncFrom(speculative, bc, speculativeQ, true);
+		checkSame(serial, sr, serialQ, speculative, pr, speculativeQ);
+	};
+
+	{
+		// A creates the accumulator and then, in nonce order, pays B, C & E; fees all go to the coinbase.
+		bytes create = Transaction(0, gasPrice, 10000, c_accumulateInit, 0, a.secret()).rlp();
+		serialQ.attemptImport(create);
+		speculativeQ.attemptImport(create);
+	}
+	send(a, b.address(), ether, bytes(), 1);
+	send(a, c.address(), 100, bytes(), 2);
+	send(a, e, 5, bytes(), 3);
+	// B spends what A gave it.
+	send(b, e, ether / 2, bytes(), 0);
+	// Two of C's with the same nonce: one goes in, the other becomes too old.
+	send(c, e, 1, bytes(), 0);
+	send(c, e, 2, bytes(), 0);
+	// D's fits in the block's gas only if it comes early enough; its next is from the future.
+	send(d, e, 1, bytes(), 0, 900000);
+	send(d, e, 1, bytes(), 5);
+	sync();
+
+	// Then everyone adds to the accumulator, each reading what the others stored.
+	send(a, accumulator, 0, h256(u256(3)).asBytes(), 4);
+	send(b, accumulator, 0, h256(u256(5)).asBytes(), 1);
+	send(c, accumulator, 0, h256(u256(7)).asBytes(), 1);
+	send(d, accumulator, 0, h256(u256(11)).asBytes(), 1);
+	send(a, accumulator, 0, h256(u256(13)).asBytes(), 5);
+	sync();
+
+	BOOST_CHECK(serial.storage(accumulator, 0) > 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
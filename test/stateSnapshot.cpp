@@ -0,0 +1,181 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file stateSnapshot.cpp
+ * @date 2015
+ * Checks that reads through the flat state snapshot agree with the trie.
+ */
+
+#include <boost/test/unit_test.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <libethereum/BlockChain.h>
+#include <libethereum/State.h>
+#include <libethereum/StateSnapshot.h>
+#include "TestHelper.h"
+using namespace std;
+using namespace dev;
+using namespace dev::eth;
+
+namespace
+{
+
+/// Runtime: stores calldata[32] at calldata[0] and then, if calldata[64] is non-zero, suicides to the caller.
+bytes const c_storeOrDie = fromHex("602035" "600035" "55" "33" "604035" "600f57" "00" "5b" "ff");
+/// Init: returns the 17 bytes of runtime that follow it.
+bytes const c_storeOrDieInit = fromHex("601180600b6000396000f3") + c_storeOrDie;
+
+/// A block chain and state DB of their own, in a fresh directory.
+struct Node
+{
+	explicit Node(bool _flat):
+		path((boost::filesystem::temp_directory_path() / boost::filesystem::unique_path()).string()),
+		db(openDB(path, _flat)),
+		bc(path, true)
+	{
+		// Commits the genesis state to the DB.
+		State s(Address(), db);
+	}
+
+	static OverlayDB openDB(string const& _path, bool _flat)
+	{
+		StateSnapshot::setEnabled(_flat);
+		auto ret = State::openDB(_path, true);
+		StateSnapshot::setEnabled(false);
+		return ret;
+	}
+
+	/// @returns a State at the head of our chain.
+	State head()
+	{
+		State ret(Address(), db, BaseState::Empty);
+		ret.sync(bc);
+		return ret;
+	}
+
+	string path;
+	OverlayDB db;
+	BlockChain bc;
+};
+
+/// Mine a block of @a _txs on @a _s, at the head of @a _n's chain, import it there and @returns it.
+bytes mineBlock(State& _s, Node& _n, vector<bytes> const& _txs = vector<bytes>())
+{
+	_s.sync(_n.bc);
+	for (auto const& tx: _txs)
+		_s.execute(_n.bc, tx);
+	_s.commitToMine(_n.bc);
+	while (!_s.mine(100, true).completed) {}
+	_s.completeMine();
+	bytes ret = _s.blockData();
+	BOOST_REQUIRE(!_n.bc.attemptImport(ret, _n.db).empty());
+	_s.sync(_n.bc);
+	return ret;
+}
+
+bytes call(u256 _key, u256 _value, bool _die)
+{
+	return h256(_key).asBytes() + h256(_value).asBytes() + h256(u256(_die ? 1 : 0)).asBytes();
+}
+
+/// Require that the heads of @a _flat (answering through its snapshot) and @a _trie agree on everything about @a _as.
+void checkSame(Node& _flat, Node& _trie, vector<Address> const& _as)
+{
+	State f = _flat.head();
+	State t = _trie.head();
+	BOOST_REQUIRE_EQUAL(f.rootHash(), t.rootHash());
+	// Otherwise we'd be testing the trie against itself.
+	BOOST_REQUIRE_EQUAL(StateSnapshot::of(_flat.db.db())->root(), f.rootHash());
+	BOOST_REQUIRE(!StateSnapshot::of(_trie.db.db()));
+
+	for (auto const& a: _as)
+	{
+		BOOST_CHECK_EQUAL(f.addressInUse(a), t.addressInUse(a));
+		BOOST_CHECK_EQUAL(f.balance(a), t.balance(a));
+		BOOST_CHECK_EQUAL(f.transactionsFrom(a), t.transactionsFrom(a));
+		BOOST_CHECK(f.code(a) == t.code(a));
+		for (unsigned k = 0; k < 4; ++k)
+			BOOST_CHECK_EQUAL(f.storage(a, k), t.storage(a, k));
+		BOOST_CHECK(f.storage(a) == t.storage(a));
+	}
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(StateSnapshotTests)
+
+BOOST_AUTO_TEST_CASE(snapshotMatchesTrie)
+{
+	KeyPair minerA = sha3("snapshot miner A");
+	KeyPair minerB = sha3("snapshot miner B");
+	Address you = right160(sha3("snapshot recipient"));
+	Address contract = right160(sha3(rlpList(minerA.address(), u256(0))));
+	vector<Address> all = { minerA.address(), minerB.address(), you, contract };
+
+	Node flat(true);
+	Node trie(false);
+	BOOST_REQUIRE(StateSnapshot::of(flat.db.db()));
+
+	// Our chain: each block mined on the flat node and imported into the trie-only one.
+	State a(minerA.address(), flat.db);
+	auto mine = [&](vector<bytes> const& _txs)
+	{
+		bytes b = mineBlock(a, flat, _txs);
+		BOOST_REQUIRE(!trie.bc.attemptImport(b, trie.db).empty());
+		checkSame(flat, trie, all);
+	};
+	auto tx = [&](Address const& _to, u256 _value, bytes const& _data, u256 _nonce)
+	{
+		return Transaction(_value, 1, 10000, _to, _data, _nonce, minerA.secret()).rlp();
+	};
+
+	// Some ether to play with.
+	mine({});
+	// Create the contract and pay someone.
+	mine({ Transaction(0, 1, 10000, c_storeOrDieInit, 0, minerA.secret()).rlp(), tx(you, 1000, bytes(), 1) });
+	// Store.
+	mine({ tx(contract, 0, call(1, 0x42, false), 2), tx(contract, 0, call(2, 7, false), 3) });
+	// Overwrite, clear and kill.
+	mine({ tx(contract, 0, call(2, 8, false), 4), tx(contract, 0, call(1, 0, true), 5) });
+	// Bring it back, as a plain account with no storage.
+	mine({ tx(contract, 5, bytes(), 6) });
+
+	// A longer chain from genesis, mined elsewhere, that leaves ours behind.
+	Node other(false);
+	State b(minerB.address(), other.db);
+	vector<bytes> blocks;
+	blocks.push_back(mineBlock(b, other));
+	blocks.push_back(mineBlock(b, other, { Transaction(2000, 1, 10000, you, bytes(), 0, minerB.secret()).rlp() }));
+	for (unsigned i = 0; i < 5; ++i)
+		blocks.push_back(mineBlock(b, other));
+	for (auto const& block: blocks)
+	{
+		flat.bc.attemptImport(block, flat.db);
+		trie.bc.attemptImport(block, trie.db);
+	}
+	BOOST_REQUIRE_EQUAL(flat.bc.currentHash(), other.bc.currentHash());
+
+	// The snapshot was left on our old head; it can't follow, so it must be rewritten.
+	a.sync(flat.bc);
+	BOOST_REQUIRE(StateSnapshot::of(flat.db.db())->root() != a.rootHash());
+	BOOST_REQUIRE(a.syncSnapshot());
+	checkSame(flat, trie, all);
+
+	// And it follows from there.
+	mine({});
+	mine({ tx(you, 1, bytes(), 0) });
+}
+
+BOOST_AUTO_TEST_SUITE_END()
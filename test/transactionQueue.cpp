@@ -0,0 +1,108 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file transactionQueue.cpp
+ * @date 2015
+ * Checks the order in which the TransactionQueue hands out newly ready transactions.
+ */
+
+#include <boost/test/unit_test.hpp>
+#include <libethereum/Transaction.h>
+#include <libethereum/TransactionQueue.h>
+using namespace std;
+using namespace dev;
+using namespace dev::eth;
+
+namespace
+{
+
+bytes tx(KeyPair const& _from, u256 _nonce, u256 _value = 1)
+{
+	return Transaction(_value, 10 * szabo, 10000, right160(sha3("transaction queue recipient")), bytes(), _nonce, _from.secret()).rlp();
+}
+
+/// @returns the hashes of those that became ready after @a _since, in the order they did, moving @a _since on.
+h256s since(TransactionQueue const& _tq, unsigned& io_since)
+{
+	h256s ret;
+	unsigned now;
+	for (auto const& i: _tq.transactionsSince(io_since, now))
+	{
+		BOOST_CHECK(i.first > io_since && i.first <= now);
+		BOOST_CHECK(i.second.second == _tq.transactions().at(i.second.first));
+		ret.push_back(i.second.first);
+	}
+	io_since = now;
+	return ret;
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(TransactionQueueTests)
+
+BOOST_AUTO_TEST_CASE(readyOrder)
+{
+	KeyPair a = sha3("transaction queue sender A");
+	KeyPair b = sha3("transaction queue sender B");
+	bytes a0 = tx(a, 0);
+	bytes a1 = tx(a, 1);
+	bytes b0 = tx(b, 0);
+	bytes b1 = tx(b, 1);
+
+	TransactionQueue tq;
+	BOOST_CHECK_EQUAL(tq.sequence(), 0);
+
+	// Two peers' cursors: one from the start, one that's seen nothing.
+	unsigned first = tq.sequence();
+	BOOST_REQUIRE(tq.import(&a0));
+	BOOST_REQUIRE(tq.import(&b0));
+	unsigned second = tq.sequence();
+	BOOST_CHECK_EQUAL(tq.import(vector<bytesConstRef>{ &a1, &a1, &a0 }).size(), 1);
+	BOOST_CHECK_EQUAL(tq.sequence(), 3);
+
+	BOOST_CHECK(since(tq, first) == h256s({ sha3(a0), sha3(b0), sha3(a1) }));
+	BOOST_CHECK(since(tq, second) == h256s({ sha3(a1) }));
+	BOOST_CHECK(since(tq, first).empty());
+
+	// Those already known don't become ready again.
+	BOOST_CHECK(!tq.import(&b0));
+	BOOST_CHECK_EQUAL(tq.sequence(), 3);
+	BOOST_CHECK(since(tq, first).empty());
+
+	// A dropped one is gone from everyone's view, before or after their cursor.
+	tq.drop(sha3(b0));
+	unsigned fromStart = 0;
+	BOOST_CHECK(since(tq, fromStart) == h256s({ sha3(a0), sha3(a1) }));
+	BOOST_CHECK(since(tq, first).empty());
+
+	// One held back for the future isn't handed out...
+	BOOST_REQUIRE(tq.import(&b1));
+	tq.setFuture(make_pair(sha3(b1), b1));
+	BOOST_CHECK_EQUAL(tq.items().second, 1);
+	BOOST_CHECK(since(tq, first).empty());
+	fromStart = 0;
+	BOOST_CHECK_EQUAL(since(tq, fromStart).size(), 2);
+
+	// ...until it's ready again, when it comes after everything before, even for a cursor that passed it.
+	BOOST_REQUIRE(tq.import(&b0));
+	tq.noteGood(make_pair(sha3(b0), b0));
+	BOOST_CHECK_EQUAL(tq.items().second, 0);
+	BOOST_CHECK(since(tq, first) == h256s({ sha3(b0), sha3(b1) }));
+	fromStart = 0;
+	BOOST_CHECK(since(tq, fromStart) == h256s({ sha3(a0), sha3(a1), sha3(b0), sha3(b1) }));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -25,7 +25,7 @@
 #include "JsonSpiritHeaders.h"
 #include <libdevcore/CommonIO.h>
 #include <libdevcrypto/TrieDB.h>
-#include "TrieHash.h"
+#include <libdevcrypto/TrieHash.h>
 #include "MemTrie.h"
 #include <boost/test/unit_test.hpp>
 #include "TestHelper.h"
@@ -424,6 +424,71 @@ BOOST_AUTO_TEST_CASE(trieStess)
 	}
 }
 
+BOOST_AUTO_TEST_CASE(trieCache)
+{
+	cnote << "Testing TrieCache...";
+	TrieCache c(1000);
+	h256 a = sha3("a");
+	BOOST_REQUIRE(!c.lookup(a));
+	c.insert(a, make_shared<string const>(300, 'a'));
+	BOOST_REQUIRE(c.lookup(a) && *c.lookup(a) == string(300, 'a'));
+
+	// Pushing the current generation over half the limit retires it; older entries then fall out altogether.
+	for (unsigned i = 0; i < 10; ++i)
+		c.insert(sha3(toString(i)), make_shared<string const>(300, 'x'));
+	BOOST_REQUIRE(!c.lookup(a));
+	BOOST_REQUIRE(c.stats().bytes <= 1000);
+
+	// Reads through a trie are served from the process-wide cache once the nodes have been seen.
+	MemoryDB dm;
+	GenericTrieDB<MemoryDB> d(&dm);
+	d.init();
+	StringMap m;
+	for (int i = 0; i < 100; ++i)
+	{
+		auto k = randomWord();
+		m[k] = toString(i);
+		d.insert(k, m[k]);
+	}
+	for (auto const& i: m)
+		BOOST_REQUIRE_EQUAL(d.at(i.first), i.second);
+	unsigned hits = TrieCache::get().stats().hits;
+	for (auto const& i: m)
+		BOOST_REQUIRE_EQUAL(d.at(i.first), i.second);
+	BOOST_REQUIRE(TrieCache::get().stats().hits > hits);
+
+	unsigned count = 0;
+	for (auto i: d)
+	{
+		BOOST_REQUIRE_EQUAL(m[i.first.toString()], i.second.toString());
+		++count;
+	}
+	BOOST_REQUIRE_EQUAL(count, m.size());
+}
+
+BOOST_AUTO_TEST_CASE(orderedTrieRoots)
+{
+	cnote << "Testing orderedTrieRoot...";
+	BOOST_REQUIRE_EQUAL(orderedTrieRoot(vector<bytes>()), EmptyTrie);
+
+	// More than 128 items, so that the RLP of the index keys runs to two bytes.
+	MemoryDB dm;
+	GenericTrieDB<MemoryDB> d(&dm);
+	d.init();
+	vector<bytes> items;
+	for (unsigned i = 0; i < 300; ++i)
+	{
+		items.push_back(asBytes(randomWord() + toString(i)));
+		bytes k = rlp(i);
+		d.insert(&k, &items.back());
+		BOOST_REQUIRE_EQUAL(orderedTrieRoot(items), d.root());
+	}
+	vector<bytesConstRef> refs;
+	for (auto const& i: items)
+		refs.push_back(&i);
+	BOOST_REQUIRE_EQUAL(orderedTrieRoot(refs), d.root());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 